@@ -0,0 +1,805 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#include "btree.h"
+
+/* default number of elements to insert */
+#define NELEM           1000000
+/* elements visited by each range scan */
+#define RANGE_LEN       100
+/* elements per NAME_add_batch call */
+#define BATCH_LEN       4096
+/* skew of zipfian workloads */
+#define ZIPF_S          0.99
+/* longest string key (including terminator) */
+#define STR_MAX         24
+
+static int
+intcmp(int32_t a, int32_t b)
+{
+        return (a > b) - (a < b);
+}
+
+/* results are folded in here so measured loops are not optimized away */
+static volatile size_t sink;
+
+/* cache miss counter (-1 if perf_event_open is not allowed) */
+static int perf_fd = -1;
+
+/* a running measurement */
+struct meter {
+        /* start time in nanoseconds */
+        double                  mt_start;
+        /* cache misses at start */
+        long long               mt_miss;
+};
+
+/**
+ * get current time:
+ *
+ * args:
+ *      none
+ *
+ * ret:
+ *      @success:       monotonic time in nanoseconds
+ *      @failure:       does not fail
+ */
+static double
+now(void)
+{
+        struct timespec ts = {0};
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * start counting cache misses of this process:
+ *
+ * args:
+ *      none
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       perf_fd stays -1
+ */
+static void
+perf_open(void)
+{
+#ifdef __linux__
+        struct perf_event_attr attr = {0};
+
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+/**
+ * read cache miss counter:
+ *
+ * args:
+ *      none
+ *
+ * ret:
+ *      @success:       cache misses so far
+ *      @failure:       -1 if there is no counter
+ */
+static long long
+perf_read(void)
+{
+        long long v = 0;
+
+        if (perf_fd < 0 || read(perf_fd, &v, sizeof(v)) != sizeof(v))
+                return -1;
+        return v;
+}
+
+/**
+ * get resident set size of this process:
+ *
+ * args:
+ *      none
+ *
+ * ret:
+ *      @success:       resident set size in kilobytes
+ *      @failure:       -1
+ */
+static long
+rss_kb(void)
+{
+        FILE *fp = NULL;
+        long size = 0;
+        long res = -1;
+
+        fp = fopen("/proc/self/statm", "r");
+        if (fp == NULL)
+                return -1;
+        if (fscanf(fp, "%ld %ld", &size, &res) != 2)
+                res = -1;
+        fclose(fp);
+        return res < 0 ? -1 : res * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * start a measurement:
+ *
+ * args:
+ *      @mp:            pointer to meter
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static void
+meter_start(struct meter *mp)
+{
+        mp->mt_miss = perf_read();
+        mp->mt_start = now();
+}
+
+/**
+ * finish a measurement and print it as a csv row:
+ *
+ * args:
+ *      @mp:            pointer to meter
+ *      @key:           name of key type
+ *      @degree:        degree of btree (0 for sorted array baseline)
+ *      @work:          name of workload
+ *      @n:             number of operations
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static void
+meter_stop(struct meter *mp, const char *key, int degree, const char *work,
+           size_t n)
+{
+        double ns = now() - mp->mt_start;
+        long long miss = perf_read();
+
+        if (miss >= 0 && mp->mt_miss >= 0)
+                miss -= mp->mt_miss;
+        else
+                miss = -1;
+
+        printf("%s,%d,%s,%zu,%.1f,%.3f,%ld,%lld\n",
+               key, degree, work, n, ns / (double)n,
+               (double)n * 1e3 / ns, rss_kb(), miss);
+        fflush(stdout);
+}
+
+/**
+ * get next pseudo random number (xorshift64*):
+ *
+ * args:
+ *      @sp:            pointer to state (must not be 0)
+ *
+ * ret:
+ *      @success:       pseudo random number
+ *      @failure:       does not fail
+ */
+static uint64_t
+rng(uint64_t *sp)
+{
+        *sp ^= *sp >> 12;
+        *sp ^= *sp << 25;
+        *sp ^= *sp >> 27;
+        return *sp * 0x2545f4914f6cdd1dull;
+}
+
+/**
+ * shuffle an array:
+ *
+ * args:
+ *      @arr:           array
+ *      @n:             number of elements
+ *      @size:          size of elements (at most STR_MAX * 4)
+ *      @sp:            pointer to rng state
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static void
+shuffle(void *arr, size_t n, size_t size, uint64_t *sp)
+{
+        char tmp[STR_MAX << 2];
+        char *p = arr;
+        size_t i = 0;
+        size_t j = 0;
+
+        for (i = n; i > 1; i--) {
+                j = (size_t)(rng(sp) % i);
+                memcpy(tmp, p + (i - 1) * size, size);
+                memcpy(p + (i - 1) * size, p + j * size, size);
+                memcpy(p + j * size, tmp, size);
+        }
+}
+
+/**
+ * draw zipfian ranks:
+ *
+ * args:
+ *      @n:             number of ranks (rank 0 is the most popular)
+ *      @sp:            pointer to rng state
+ *
+ * ret:
+ *      @success:       array of n ranks
+ *      @failure:       exits
+ */
+static size_t *
+zipf_ranks(size_t n, uint64_t *sp)
+{
+        size_t *ranks = NULL;
+        double *cdf = NULL;
+        double sum = 0;
+        double u = 0;
+        size_t lo = 0;
+        size_t hi = 0;
+        size_t mid = 0;
+        size_t i = 0;
+
+        ranks = malloc(n * sizeof(*ranks));
+        cdf = malloc(n * sizeof(*cdf));
+        if (ranks == NULL || cdf == NULL) {
+                perror("malloc");
+                exit(EXIT_FAILURE);
+        }
+
+        for (i = 0; i < n; i++) {
+                sum += 1.0 / pow((double)(i + 1), ZIPF_S);
+                cdf[i] = sum;
+        }
+        for (i = 0; i < n; i++) {
+                u = (double)(rng(sp) >> 11) / 9007199254740992.0 * sum;
+                lo = 0;
+                hi = n - 1;
+                while (lo < hi) {
+                        mid = lo + ((hi - lo) >> 1);
+                        if (cdf[mid] < u)
+                                lo = mid + 1;
+                        else
+                                hi = mid;
+                }
+                ranks[i] = lo;
+        }
+
+        free(cdf);
+        return ranks;
+}
+
+/**
+ * define a btree and its benchmark:
+ *
+ * args:
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @CMP_FN:        element comparison function
+ *      @KEY:           prefix of search kernels
+ *      @NAME:          name of generated struct
+ *
+ * ret:
+ *      @success:       NAME ## _bench
+ *      @failure:       does not fail
+ */
+#define BENCH_DEFINE(TYPE, DEGREE, CMP_FN, KEY, NAME)                   \
+        BTREE_DEFINE_KEY(static inline, TYPE, DEGREE, CMP_FN, NAME,     \
+                         KEY)                                           \
+        BENCH_TREE(TYPE, DEGREE, NAME)
+
+/**
+ * define the benchmark of a btree:
+ *
+ * args:
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @NAME:          name of btree struct
+ *
+ * ret:
+ *      @success:       NAME ## _bench
+ *      @failure:       does not fail
+ */
+#define BENCH_TREE(TYPE, DEGREE, NAME)                                  \
+                                                                        \
+/**                                                                     \
+ * time inserts into a new NAME:                                        \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @pool:          allocate nodes from a pool?                     \
+ *      @key:           name of key type                                \
+ *      @work:          name of workload                                \
+ *      @arr:           elements to insert                              \
+ *      @n:             number of elements                              \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       exits                                           \
+ */                                                                     \
+static void                                                             \
+NAME ## _fill(struct NAME *bp,                                          \
+              bool pool,                                                \
+              const char *key,                                          \
+              const char *work,                                         \
+              TYPE *arr,                                                \
+              size_t n)                                                 \
+{                                                                       \
+        struct meter m = {0};                                           \
+        size_t i = 0;                                                   \
+                                                                        \
+        if (pool)                                                       \
+                NAME ## _init_pool(bp);                                 \
+        else                                                            \
+                NAME ## _init(bp);                                      \
+                                                                        \
+        meter_start(&m);                                                \
+        for (i = 0; i < n; i++) {                                       \
+                if (NAME ## _add(bp, arr[i]) < 0) {                     \
+                        perror(#NAME "_add");                           \
+                        exit(EXIT_FAILURE);                             \
+                }                                                       \
+        }                                                               \
+        meter_stop(&m, key, DEGREE, work, n);                           \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * time batched inserts into a new NAME:                                \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           name of key type                                \
+ *      @arr:           elements to insert                              \
+ *      @n:             number of elements                              \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       exits                                           \
+ */                                                                     \
+static void                                                             \
+NAME ## _fill_batch(struct NAME *bp,                                    \
+                    const char *key,                                    \
+                    TYPE *arr,                                          \
+                    size_t n)                                           \
+{                                                                       \
+        struct meter m = {0};                                           \
+        TYPE *tmp = NULL;                                               \
+        size_t len = 0;                                                 \
+        size_t i = 0;                                                   \
+                                                                        \
+        /* batches are sorted in place, so work on a copy */            \
+        tmp = malloc(n * sizeof(*tmp));                                 \
+        if (tmp == NULL) {                                              \
+                perror("malloc");                                       \
+                exit(EXIT_FAILURE);                                     \
+        }                                                               \
+        memcpy(tmp, arr, n * sizeof(*tmp));                             \
+        NAME ## _init_pool(bp);                                         \
+                                                                        \
+        meter_start(&m);                                                \
+        for (i = 0; i < n; i += len) {                                  \
+                len = n - i < BATCH_LEN ? n - i : BATCH_LEN;            \
+                if (NAME ## _add_batch(bp, tmp + i, len) < 0) {         \
+                        perror(#NAME "_add_batch");                     \
+                        exit(EXIT_FAILURE);                             \
+                }                                                       \
+        }                                                               \
+        meter_stop(&m, key, DEGREE, "insert_batch", n);                 \
+        free(tmp);                                                      \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * time lookups in a NAME:                                              \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           name of key type                                \
+ *      @work:          name of workload                                \
+ *      @arr:           keys to look up                                 \
+ *      @n:             number of keys                                  \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+static void                                                             \
+NAME ## _lookup(struct NAME *bp,                                        \
+                const char *key,                                        \
+                const char *work,                                       \
+                TYPE *arr,                                              \
+                size_t n)                                               \
+{                                                                       \
+        struct meter m = {0};                                           \
+        size_t hits = 0;                                                \
+        size_t i = 0;                                                   \
+                                                                        \
+        meter_start(&m);                                                \
+        for (i = 0; i < n; i++)                                         \
+                hits += NAME ## _find(bp, arr[i]) != NULL;              \
+        meter_stop(&m, key, DEGREE, work, n);                           \
+        sink += hits;                                                   \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * run every workload on NAME:                                          \
+ *                                                                      \
+ * args:                                                                \
+ *      @key:           name of key type                                \
+ *      @seq:           distinct keys in order                          \
+ *      @rnd:           seq shuffled                                    \
+ *      @zipf:          zipfian draws from seq                          \
+ *      @look:          seq shuffled again                              \
+ *      @n:             number of keys in each array                    \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       exits                                           \
+ */                                                                     \
+static void                                                             \
+NAME ## _bench(const char *key,                                         \
+               TYPE *seq,                                               \
+               TYPE *rnd,                                               \
+               TYPE *zipf,                                              \
+               TYPE *look,                                              \
+               size_t n)                                                \
+{                                                                       \
+        struct NAME ## _cursor cur = {0};                               \
+        struct meter m = {0};                                           \
+        struct NAME t = {0};                                            \
+        TYPE *ep = NULL;                                                \
+        size_t sum = 0;                                                 \
+        size_t i = 0;                                                   \
+        size_t j = 0;                                                   \
+                                                                        \
+        NAME ## _fill(&t, true, key, "insert_seq", seq, n);             \
+        NAME ## _free(&t);                                              \
+        NAME ## _fill(&t, true, key, "insert_zipf", zipf, n);           \
+        NAME ## _free(&t);                                              \
+        NAME ## _fill_batch(&t, key, rnd, n);                           \
+        NAME ## _free(&t);                                              \
+                                                                        \
+        NAME ## _fill(&t, false, key, "insert_malloc", rnd, n);         \
+        meter_start(&m);                                                \
+        NAME ## _free(&t);                                              \
+        meter_stop(&m, key, DEGREE, "free_malloc", n);                  \
+                                                                        \
+        NAME ## _fill(&t, true, key, "insert_rand", rnd, n);            \
+        NAME ## _lookup(&t, key, "find", look, n);                      \
+        NAME ## _lookup(&t, key, "find_zipf", zipf, n);                 \
+                                                                        \
+        meter_start(&m);                                                \
+        BTREE_FOREACH(NAME, &cur, &t, ep)                               \
+                sum += *(unsigned char *)ep;                            \
+        meter_stop(&m, key, DEGREE, "scan", n);                         \
+                                                                        \
+        meter_start(&m);                                                \
+        for (i = 0; i < n / RANGE_LEN; i++) {                           \
+                NAME ## _cursor_seek(&cur, &t, look[i]);                \
+                for (j = 0; j < RANGE_LEN; j++) {                       \
+                        ep = NAME ## _cursor_get(&cur);                 \
+                        if (ep == NULL)                                 \
+                                break;                                  \
+                        sum += *(unsigned char *)ep;                    \
+                        NAME ## _cursor_next(&cur);                     \
+                }                                                       \
+        }                                                               \
+        meter_stop(&m, key, DEGREE, "range", n / RANGE_LEN);            \
+                                                                        \
+        meter_start(&m);                                                \
+        NAME ## _free(&t);                                              \
+        meter_stop(&m, key, DEGREE, "free", n);                         \
+        sink += sum;                                                    \
+}
+
+/**
+ * define a sorted array baseline for keys a btree called NAME holds:
+ *
+ * args:
+ *      @TYPE:          element type
+ *      @CMP_FN:        element comparison function
+ *      @KEY:           prefix of search kernels
+ *      @NAME:          name of a btree defined by BENCH_DEFINE
+ *
+ * ret:
+ *      @success:       NAME ## _array_bench
+ *      @failure:       does not fail
+ */
+#define BENCH_ARRAY(TYPE, CMP_FN, KEY, NAME)                            \
+                                                                        \
+/**                                                                     \
+ * time lookups in a sorted array:                                      \
+ *                                                                      \
+ * args:                                                                \
+ *      @arr:           sorted array                                    \
+ *      @key:           name of key type                                \
+ *      @work:          name of workload                                \
+ *      @keys:          keys to look up                                 \
+ *      @n:             number of elements and keys                     \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+static void                                                             \
+NAME ## _array_lookup(TYPE *arr,                                        \
+                      const char *key,                                  \
+                      const char *work,                                 \
+                      TYPE *keys,                                       \
+                      size_t n)                                         \
+{                                                                       \
+        struct meter m = {0};                                           \
+        size_t hits = 0;                                                \
+        size_t i = 0;                                                   \
+        int k = 0;                                                      \
+                                                                        \
+        meter_start(&m);                                                \
+        for (i = 0; i < n; i++) {                                       \
+                k = KEY ## _lower(arr, (int)n, keys[i]);                \
+                hits += k < (int)n && CMP_FN(arr[k], keys[i]) == 0;     \
+        }                                                               \
+        meter_stop(&m, key, 0, work, n);                                \
+        sink += hits;                                                   \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * run every workload a sorted array supports:                          \
+ *                                                                      \
+ * args:                                                                \
+ *      @key:           name of key type                                \
+ *      @rnd:           distinct keys in random order                   \
+ *      @zipf:          zipfian draws from rnd                          \
+ *      @look:          rnd shuffled again                              \
+ *      @n:             number of keys in each array                    \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       exits                                           \
+ */                                                                     \
+static void                                                             \
+NAME ## _array_bench(const char *key,                                   \
+                     TYPE *rnd,                                         \
+                     TYPE *zipf,                                        \
+                     TYPE *look,                                        \
+                     size_t n)                                          \
+{                                                                       \
+        struct meter m = {0};                                           \
+        TYPE *arr = NULL;                                               \
+        size_t sum = 0;                                                 \
+        size_t i = 0;                                                   \
+        size_t j = 0;                                                   \
+        int k = 0;                                                      \
+                                                                        \
+        arr = malloc(n * sizeof(*arr));                                 \
+        if (arr == NULL) {                                              \
+                perror("malloc");                                       \
+                exit(EXIT_FAILURE);                                     \
+        }                                                               \
+        memcpy(arr, rnd, n * sizeof(*arr));                             \
+                                                                        \
+        meter_start(&m);                                                \
+        qsort(arr, n, sizeof(*arr), NAME ## _elem_cmp);                 \
+        meter_stop(&m, key, 0, "qsort", n);                             \
+                                                                        \
+        NAME ## _array_lookup(arr, key, "find", look, n);               \
+        NAME ## _array_lookup(arr, key, "find_zipf", zipf, n);          \
+                                                                        \
+        meter_start(&m);                                                \
+        for (i = 0; i < n; i++)                                         \
+                sum += *(unsigned char *)&arr[i];                       \
+        meter_stop(&m, key, 0, "scan", n);                              \
+                                                                        \
+        meter_start(&m);                                                \
+        for (i = 0; i < n / RANGE_LEN; i++) {                           \
+                k = KEY ## _lower(arr, (int)n, look[i]);                \
+                for (j = (size_t)k; j < n && j < k + RANGE_LEN; j++)    \
+                        sum += *(unsigned char *)&arr[j];               \
+        }                                                               \
+        meter_stop(&m, key, 0, "range", n / RANGE_LEN);                 \
+                                                                        \
+        free(arr);                                                      \
+        sink += sum;                                                    \
+}
+
+BENCH_DEFINE(int32_t, 4, intcmp, btree_i32, int4)
+BENCH_DEFINE(int32_t, 8, intcmp, btree_i32, int8)
+BENCH_DEFINE(int32_t, 16, intcmp, btree_i32, int16)
+BENCH_DEFINE(int32_t, 32, intcmp, btree_i32, int32)
+BENCH_DEFINE(int32_t, 64, intcmp, btree_i32, int64)
+BENCH_DEFINE(int32_t, 128, intcmp, btree_i32, int128)
+BENCH_DEFINE(int32_t, 256, intcmp, btree_i32, int256)
+BENCH_ARRAY(int32_t, intcmp, btree_i32, int8)
+
+BENCH_DEFINE(struct btree_str, 4, btree_str_cmp, btree_str, str4)
+BENCH_DEFINE(struct btree_str, 8, btree_str_cmp, btree_str, str8)
+BENCH_DEFINE(struct btree_str, 16, btree_str_cmp, btree_str, str16)
+BENCH_DEFINE(struct btree_str, 32, btree_str_cmp, btree_str, str32)
+BENCH_DEFINE(struct btree_str, 64, btree_str_cmp, btree_str, str64)
+BENCH_DEFINE(struct btree_str, 128, btree_str_cmp, btree_str, str128)
+BENCH_DEFINE(struct btree_str, 256, btree_str_cmp, btree_str, str256)
+BENCH_ARRAY(struct btree_str, btree_str_cmp, btree_str, str8)
+
+/* plain strings, as BTREE_DEFINE stores them without a KEY */
+BTREE_DEFINE(static inline, char *, 8, strcmp, cstr8)
+BENCH_TREE(char *, 8, cstr8)
+
+/**
+ * allocate an array or exit:
+ *
+ * args:
+ *      @n:             number of elements
+ *      @size:          size of elements
+ *
+ * ret:
+ *      @success:       pointer to array
+ *      @failure:       exits
+ */
+static void *
+xalloc(size_t n, size_t size)
+{
+        void *p = calloc(n, size);
+
+        if (p == NULL) {
+                perror("calloc");
+                exit(EXIT_FAILURE);
+        }
+        return p;
+}
+
+/**
+ * run int key workloads:
+ *
+ * args:
+ *      @n:             number of keys
+ *      @ranks:         zipfian ranks
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       exits
+ */
+static void
+bench_int(size_t n, size_t *ranks)
+{
+        int32_t *seq = xalloc(n, sizeof(*seq));
+        int32_t *rnd = xalloc(n, sizeof(*rnd));
+        int32_t *zipf = xalloc(n, sizeof(*zipf));
+        int32_t *look = xalloc(n, sizeof(*look));
+        uint64_t s = 88172645463325252ull;
+        size_t i = 0;
+
+        for (i = 0; i < n; i++)
+                seq[i] = (int32_t)(i << 1);
+        memcpy(rnd, seq, n * sizeof(*seq));
+        shuffle(rnd, n, sizeof(*rnd), &s);
+        memcpy(look, seq, n * sizeof(*seq));
+        shuffle(look, n, sizeof(*look), &s);
+        for (i = 0; i < n; i++)
+                zipf[i] = rnd[ranks[i]];
+
+        int4_bench("int", seq, rnd, zipf, look, n);
+        int8_bench("int", seq, rnd, zipf, look, n);
+        int16_bench("int", seq, rnd, zipf, look, n);
+        int32_bench("int", seq, rnd, zipf, look, n);
+        int64_bench("int", seq, rnd, zipf, look, n);
+        int128_bench("int", seq, rnd, zipf, look, n);
+        int256_bench("int", seq, rnd, zipf, look, n);
+        int8_array_bench("int", rnd, zipf, look, n);
+
+        free(seq);
+        free(rnd);
+        free(zipf);
+        free(look);
+}
+
+/**
+ * run string key workloads:
+ *
+ * args:
+ *      @n:             number of keys
+ *      @ranks:         zipfian ranks
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       exits
+ */
+static void
+bench_str(size_t n, size_t *ranks)
+{
+        struct btree_str *seq = xalloc(n, sizeof(*seq));
+        struct btree_str *rnd = xalloc(n, sizeof(*rnd));
+        struct btree_str *zipf = xalloc(n, sizeof(*zipf));
+        struct btree_str *look = xalloc(n, sizeof(*look));
+        char **cstr[4] = {NULL};
+        char *buf = xalloc(n, STR_MAX);
+        uint64_t s = 88172645463325252ull;
+        size_t i = 0;
+        int len = 0;
+
+        /* hashed head so prefixes spread out, index tail keeps it unique */
+        for (i = 0; i < n; i++) {
+                len = snprintf(buf + i * STR_MAX, STR_MAX, "%08x:%zu",
+                               (unsigned)(rng(&s) >> 32), i);
+                seq[i] = btree_str_make(buf + i * STR_MAX, (size_t)len);
+        }
+        qsort(seq, n, sizeof(*seq), str8_elem_cmp);
+        memcpy(rnd, seq, n * sizeof(*seq));
+        shuffle(rnd, n, sizeof(*rnd), &s);
+        memcpy(look, seq, n * sizeof(*seq));
+        shuffle(look, n, sizeof(*look), &s);
+        for (i = 0; i < n; i++)
+                zipf[i] = rnd[ranks[i]];
+
+        str4_bench("str", seq, rnd, zipf, look, n);
+        str8_bench("str", seq, rnd, zipf, look, n);
+        str16_bench("str", seq, rnd, zipf, look, n);
+        str32_bench("str", seq, rnd, zipf, look, n);
+        str64_bench("str", seq, rnd, zipf, look, n);
+        str128_bench("str", seq, rnd, zipf, look, n);
+        str256_bench("str", seq, rnd, zipf, look, n);
+        str8_array_bench("str", rnd, zipf, look, n);
+
+        /* same strings without the inline prefix (and in strcmp order) */
+        for (i = 0; i < 4; i++)
+                cstr[i] = xalloc(n, sizeof(*cstr[i]));
+        for (i = 0; i < n; i++) {
+                cstr[0][i] = seq[i].bs_ptr;
+                cstr[1][i] = rnd[i].bs_ptr;
+                cstr[2][i] = zipf[i].bs_ptr;
+                cstr[3][i] = look[i].bs_ptr;
+        }
+        cstr8_bench("cstr", cstr[0], cstr[1], cstr[2], cstr[3], n);
+        for (i = 0; i < 4; i++)
+                free(cstr[i]);
+
+        free(seq);
+        free(rnd);
+        free(zipf);
+        free(look);
+        free(buf);
+}
+
+/*
+ * prints one csv row per workload:
+ *
+ *      key,degree,workload,n,ns_per_op,mops,rss_kb,cache_misses
+ *
+ * degree 0 is the sorted array baseline, rss_kb is the resident set of
+ * the whole process when the workload finished and cache_misses is -1
+ * when perf_event_open is not allowed
+ */
+int
+main(int argc, char **argv)
+{
+        uint64_t s = 0x9e3779b97f4a7c15ull;
+        size_t *ranks = NULL;
+        size_t n = NELEM;
+
+        if (argc > 1)
+                n = strtoul(argv[1], NULL, 10);
+        if (n == 0)
+                n = NELEM;
+        if (n > INT32_MAX >> 1) {
+                fprintf(stderr, "btree-bench: too many elements\n");
+                return EXIT_FAILURE;
+        }
+
+        perf_open();
+        ranks = zipf_ranks(n, &s);
+        printf("key,degree,workload,n,ns_per_op,mops,rss_kb,cache_misses\n");
+        bench_int(n, ranks);
+        bench_str(n, ranks);
+        free(ranks);
+        return 0;
+}
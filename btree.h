@@ -0,0 +1,3395 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/* deepest btree a cursor can walk (nodes have at least two kids) */
+#define BTREE_MAX_HEIGHT        64
+
+/* kids of an internal node of a btree called NAME */
+#define BTREE_KIDS(NAME, np)    (((struct NAME ## _inode *)(np))->bi_kids)
+/* subtree sizes of an internal node of a ranked btree called NAME */
+#define BTREE_SIZES(NAME, np)   (((struct NAME ## _rinode *)(np))->ri_sizes)
+/* size of an internal node of a btree called NAME */
+#define BTREE_INODE_SIZE(NAME, RANKED)                                  \
+        ((RANKED) ? sizeof(struct NAME ## _rinode) :                    \
+                    sizeof(struct NAME ## _inode))
+
+/**
+ * pick a degree that makes leaves of a btree fit in a given size:
+ *
+ * args:
+ *      @TYPE:          element type (aligned to at most 8 bytes)
+ *      @BYTES:         target leaf size (e.g. 64, 256 or 4096)
+ *
+ * ret:
+ *      @success:       largest degree whose leaves fit (at least 2)
+ *      @failure:       does not fail
+ */
+#define BTREE_DEGREE_FOR(TYPE, BYTES)                                   \
+        ((int)(((BYTES) - 8) / sizeof(TYPE) + 1) / 2 < 2 ? 2 :          \
+         (int)(((BYTES) - 8) / sizeof(TYPE) + 1) / 2)
+
+/* alignment of nodes handed out by a btree_pool */
+#define BTREE_POOL_ALIGN        64
+/* size of chunks a btree_pool carves nodes out of */
+#define BTREE_POOL_CHUNK        (1 << 16)
+
+/* chunk of btree_pool memory (header of each chunk) */
+struct btree_chunk {
+        /* next chunk in pool */
+        struct btree_chunk      *ch_next;
+};
+
+/* free btree_pool slot */
+struct btree_slot {
+        /* next free slot */
+        struct btree_slot       *sl_next;
+};
+
+/* pool of fixed size, cache line aligned objects */
+struct btree_pool {
+        /* chunks allocated so far */
+        struct btree_chunk      *pl_chunks;
+        /* recycled slots */
+        struct btree_slot       *pl_free;
+        /* next unused byte in current chunk */
+        char                    *pl_next;
+        /* end of current chunk */
+        char                    *pl_end;
+        /* size of objects (0 if pool is unused) */
+        size_t                  pl_size;
+};
+
+/**
+ * initialize a btree_pool:
+ *
+ * args:
+ *      @pp:            pointer to btree_pool
+ *      @size:          size of objects in pool (0 for an unused pool)
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static inline void
+btree_pool_init(struct btree_pool *pp, size_t size)
+{
+        if (size != 0 && size < sizeof(struct btree_slot))
+                size = sizeof(struct btree_slot);
+
+        pp->pl_chunks = NULL;
+        pp->pl_free = NULL;
+        pp->pl_next = NULL;
+        pp->pl_end = NULL;
+        pp->pl_size = (size + BTREE_POOL_ALIGN - 1) &
+                      ~(size_t)(BTREE_POOL_ALIGN - 1);
+}
+
+/**
+ * get an object from a btree_pool:
+ *
+ * args:
+ *      @pp:            pointer to btree_pool
+ *
+ * ret:
+ *      @success:       pointer to object
+ *      @failure:       NULL and errno set
+ */
+static inline void *
+btree_pool_get(struct btree_pool *pp)
+{
+        struct btree_chunk *cp = NULL;
+        struct btree_slot *sp = NULL;
+        size_t size = BTREE_POOL_CHUNK;
+        void *p = NULL;
+
+        if (pp->pl_free != NULL) {
+                sp = pp->pl_free;
+                pp->pl_free = sp->sl_next;
+                return sp;
+        }
+
+        if ((size_t)(pp->pl_end - pp->pl_next) < pp->pl_size) {
+                /* chunk header takes up the first aligned slot */
+                if (size < BTREE_POOL_ALIGN + pp->pl_size)
+                        size = BTREE_POOL_ALIGN + pp->pl_size;
+                cp = aligned_alloc(BTREE_POOL_ALIGN, size);
+                if (cp == NULL)
+                        return NULL;
+                cp->ch_next = pp->pl_chunks;
+                pp->pl_chunks = cp;
+                pp->pl_next = (char *)cp + BTREE_POOL_ALIGN;
+                pp->pl_end = (char *)cp + size;
+        }
+
+        p = pp->pl_next;
+        pp->pl_next += pp->pl_size;
+        return p;
+}
+
+/**
+ * return an object to a btree_pool:
+ *
+ * args:
+ *      @pp:            pointer to btree_pool
+ *      @p:             pointer to object
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static inline void
+btree_pool_put(struct btree_pool *pp, void *p)
+{
+        struct btree_slot *sp = p;
+
+        sp->sl_next = pp->pl_free;
+        pp->pl_free = sp;
+}
+
+/**
+ * free every object in a btree_pool at once:
+ *
+ * args:
+ *      @pp:            pointer to btree_pool
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static inline void
+btree_pool_free(struct btree_pool *pp)
+{
+        struct btree_chunk *cp = NULL;
+
+        while (pp->pl_chunks != NULL) {
+                cp = pp->pl_chunks;
+                pp->pl_chunks = cp->ch_next;
+                free(cp);
+        }
+
+        pp->pl_free = NULL;
+        pp->pl_next = NULL;
+        pp->pl_end = NULL;
+}
+
+/**
+ * get bytes held by a btree_pool:
+ *
+ * args:
+ *      @pp:            pointer to btree_pool
+ *
+ * ret:
+ *      @success:       bytes of every chunk in pool
+ *      @failure:       does not fail
+ */
+static inline size_t
+btree_pool_bytes(struct btree_pool *pp)
+{
+        struct btree_chunk *cp = NULL;
+        size_t size = BTREE_POOL_CHUNK;
+        size_t bytes = 0;
+
+        if (size < BTREE_POOL_ALIGN + pp->pl_size)
+                size = BTREE_POOL_ALIGN + pp->pl_size;
+        for (cp = pp->pl_chunks; cp != NULL; cp = cp->ch_next)
+                bytes += size;
+        return bytes;
+}
+
+/* caller supplied node allocator */
+struct btree_alloc {
+        /* get size bytes (NULL and errno set on failure) */
+        void                    *(*ba_alloc)(void *ctx, size_t size);
+        /* release p, which ba_alloc returned for size bytes */
+        void                    (*ba_free)(void *ctx, void *p, size_t size);
+        /* first argument of ba_alloc and ba_free */
+        void                    *ba_ctx;
+};
+
+/* size of pages in a saved btree file */
+#define BTREE_FILE_PAGE         4096
+/* magic number at start of a saved btree file */
+#define BTREE_FILE_MAGIC        "BTREE01"
+
+/* header of a saved btree file (alone in the first page) */
+struct btree_file {
+        /* BTREE_FILE_MAGIC */
+        char                    bf_magic[8];
+        /* degree of saved btree */
+        uint32_t                bf_degree;
+        /* size of an element */
+        uint32_t                bf_elem;
+        /* number of elements */
+        uint64_t                bf_count;
+        /* offset of root node (0 if btree is empty) */
+        uint64_t                bf_root;
+        /* offset of end of nodes */
+        uint64_t                bf_nodes;
+        /* offset of heap */
+        uint64_t                bf_heap;
+        /* size of heap */
+        uint64_t                bf_heap_len;
+        /* FNV-1a hash of everything after the first page */
+        uint64_t                bf_sum;
+};
+
+/* variable length data (such as strings) saved along with a btree */
+struct btree_heap {
+        /* heap contents */
+        char                    *bh_buf;
+        /* bytes in use */
+        size_t                  bh_len;
+        /* bytes allocated */
+        size_t                  bh_cap;
+};
+
+/* buffered writer used to save a btree */
+struct btree_writer {
+        /* file being written */
+        int                     bw_fd;
+        /* file offset of next byte */
+        uint64_t                bw_off;
+        /* running hash of bytes written */
+        uint64_t                bw_sum;
+        /* bytes waiting in bw_buf */
+        size_t                  bw_len;
+        /* bytes not yet written */
+        char                    bw_buf[BTREE_FILE_PAGE << 4];
+};
+
+/* saved btree mapped into memory */
+struct btree_map {
+        /* start of mapping */
+        char                    *bm_base;
+        /* size of mapping */
+        size_t                  bm_size;
+        /* header of saved btree */
+        const struct btree_file *bm_file;
+        /* heap of saved btree */
+        const char              *bm_heap;
+        /* size of heap */
+        size_t                  bm_heap_len;
+};
+
+/**
+ * add bytes to an FNV-1a hash:
+ *
+ * args:
+ *      @sum:           hash so far
+ *      @p:             pointer to bytes
+ *      @n:             number of bytes
+ *
+ * ret:
+ *      @success:       new hash
+ *      @failure:       does not fail
+ */
+static inline uint64_t
+btree_sum(uint64_t sum, const void *p, size_t n)
+{
+        const unsigned char *cp = p;
+
+        while (n-- > 0) {
+                sum ^= *cp++;
+                sum *= 0x100000001b3ull;
+        }
+        return sum;
+}
+
+/**
+ * initialize a btree_heap:
+ *
+ * args:
+ *      @hp:            pointer to btree_heap
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static inline void
+btree_heap_init(struct btree_heap *hp)
+{
+        hp->bh_buf = NULL;
+        hp->bh_len = 0;
+        hp->bh_cap = 0;
+}
+
+/**
+ * copy bytes into a btree_heap:
+ *
+ * args:
+ *      @hp:            pointer to btree_heap
+ *      @p:             pointer to bytes
+ *      @n:             number of bytes
+ *
+ * ret:
+ *      @success:       offset of bytes in heap
+ *      @failure:       SIZE_MAX and errno set
+ */
+static inline size_t
+btree_heap_add(struct btree_heap *hp, const void *p, size_t n)
+{
+        size_t cap = hp->bh_cap ? hp->bh_cap : BTREE_FILE_PAGE;
+        size_t off = hp->bh_len;
+        char *buf = NULL;
+
+        while (cap - hp->bh_len < n)
+                cap <<= 1;
+        if (cap != hp->bh_cap) {
+                buf = realloc(hp->bh_buf, cap);
+                if (buf == NULL)
+                        return SIZE_MAX;
+                hp->bh_buf = buf;
+                hp->bh_cap = cap;
+        }
+
+        if (n != 0)
+                memcpy(hp->bh_buf + off, p, n);
+        hp->bh_len += n;
+        return off;
+}
+
+/**
+ * free memory allocated by btree_heap:
+ *
+ * args:
+ *      @hp:            pointer to btree_heap
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static inline void
+btree_heap_free(struct btree_heap *hp)
+{
+        free(hp->bh_buf);
+        btree_heap_init(hp);
+}
+
+/**
+ * write out buffered bytes of a btree_writer:
+ *
+ * args:
+ *      @wp:            pointer to btree_writer
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_writer_flush(struct btree_writer *wp)
+{
+        size_t done = 0;
+        ssize_t n = 0;
+
+        while (done < wp->bw_len) {
+                n = write(wp->bw_fd, wp->bw_buf + done, wp->bw_len - done);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n < 0)
+                        return -1;
+                done += (size_t)n;
+        }
+
+        wp->bw_len = 0;
+        return 0;
+}
+
+/**
+ * write bytes through a btree_writer:
+ *
+ * args:
+ *      @wp:            pointer to btree_writer
+ *      @p:             pointer to bytes (NULL for zeros)
+ *      @n:             number of bytes
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_writer_put(struct btree_writer *wp, const void *p, size_t n)
+{
+        const char *cp = p;
+        size_t room = 0;
+
+        while (n > 0) {
+                if (wp->bw_len == sizeof(wp->bw_buf) &&
+                    btree_writer_flush(wp) < 0)
+                        return -1;
+                room = sizeof(wp->bw_buf) - wp->bw_len;
+                if (room > n)
+                        room = n;
+                if (cp != NULL) {
+                        memcpy(wp->bw_buf + wp->bw_len, cp, room);
+                        cp += room;
+                } else {
+                        memset(wp->bw_buf + wp->bw_len, 0, room);
+                }
+                wp->bw_sum = btree_sum(wp->bw_sum, wp->bw_buf + wp->bw_len,
+                                       room);
+                wp->bw_len += room;
+                wp->bw_off += room;
+                n -= room;
+        }
+
+        return 0;
+}
+
+/**
+ * pad a btree_writer with zeros up to a page boundary if a record of
+ * a given size would otherwise straddle one:
+ *
+ * args:
+ *      @wp:            pointer to btree_writer
+ *      @size:          size of next record (0 to always pad)
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_writer_align(struct btree_writer *wp, size_t size)
+{
+        size_t used = (size_t)(wp->bw_off % BTREE_FILE_PAGE);
+
+        if (used == 0 || (size != 0 && used + size <= BTREE_FILE_PAGE))
+                return 0;
+        return btree_writer_put(wp, NULL, BTREE_FILE_PAGE - used);
+}
+
+/**
+ * start saving a btree to a file (header page is left blank):
+ *
+ * args:
+ *      @wp:            pointer to btree_writer
+ *      @fd:            file open for writing, at its start
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_writer_init(struct btree_writer *wp, int fd)
+{
+        wp->bw_fd = fd;
+        wp->bw_off = 0;
+        wp->bw_len = 0;
+        if (btree_writer_put(wp, NULL, BTREE_FILE_PAGE) < 0)
+                return -1;
+        wp->bw_sum = 0xcbf29ce484222325ull;
+        return 0;
+}
+
+/**
+ * finish saving a btree to a file:
+ *
+ * args:
+ *      @wp:            pointer to btree_writer
+ *      @hp:            pointer to btree_heap to append
+ *      @fp:            header to fill in and write to the first page
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_writer_finish(struct btree_writer *wp,
+                    struct btree_heap *hp,
+                    struct btree_file *fp)
+{
+        fp->bf_nodes = wp->bw_off;
+        if (btree_writer_align(wp, 0) < 0)
+                return -1;
+        fp->bf_heap = wp->bw_off;
+        fp->bf_heap_len = hp->bh_len;
+        if (btree_writer_put(wp, hp->bh_buf, hp->bh_len) < 0)
+                return -1;
+        if (btree_writer_flush(wp) < 0)
+                return -1;
+
+        memcpy(fp->bf_magic, BTREE_FILE_MAGIC, sizeof(fp->bf_magic));
+        fp->bf_sum = wp->bw_sum;
+        if (pwrite(wp->bw_fd, fp, sizeof(*fp), 0) != (ssize_t)sizeof(*fp))
+                return -1;
+        return 0;
+}
+
+/**
+ * map a saved btree into memory:
+ *
+ * args:
+ *      @mp:            pointer to btree_map
+ *      @path:          path of saved btree
+ *      @degree:        expected degree
+ *      @elem:          expected element size
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_map_open(struct btree_map *mp, const char *path, int degree,
+               size_t elem)
+{
+        const struct btree_file *fp = NULL;
+        struct stat st = {0};
+        void *base = NULL;
+        int fd = -1;
+
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return -1;
+        if (fstat(fd, &st) < 0) {
+                close(fd);
+                return -1;
+        }
+        if (st.st_size < BTREE_FILE_PAGE) {
+                close(fd);
+                errno = EINVAL;
+                return -1;
+        }
+
+        /* only the pages lookups touch are ever read in */
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+                return -1;
+
+        fp = base;
+        if (memcmp(fp->bf_magic, BTREE_FILE_MAGIC, sizeof(fp->bf_magic)) ||
+            fp->bf_degree != (uint32_t)degree || fp->bf_elem != elem ||
+            fp->bf_nodes < BTREE_FILE_PAGE || fp->bf_heap < fp->bf_nodes ||
+            fp->bf_heap > (uint64_t)st.st_size ||
+            fp->bf_heap_len > (uint64_t)st.st_size - fp->bf_heap ||
+            (fp->bf_root != 0 && (fp->bf_root < BTREE_FILE_PAGE ||
+                                  fp->bf_root >= fp->bf_nodes))) {
+                munmap(base, (size_t)st.st_size);
+                errno = EINVAL;
+                return -1;
+        }
+
+        mp->bm_base = base;
+        mp->bm_size = (size_t)st.st_size;
+        mp->bm_file = fp;
+        mp->bm_heap = mp->bm_base + fp->bf_heap;
+        mp->bm_heap_len = (size_t)fp->bf_heap_len;
+        return 0;
+}
+
+/**
+ * check the hash of a mapped btree (reads every page):
+ *
+ * args:
+ *      @mp:            pointer to btree_map
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_map_verify(const struct btree_map *mp)
+{
+        uint64_t sum = 0xcbf29ce484222325ull;
+        size_t end = (size_t)(mp->bm_file->bf_heap +
+                              mp->bm_file->bf_heap_len);
+
+        if (end < BTREE_FILE_PAGE || end > mp->bm_size) {
+                errno = EBADMSG;
+                return -1;
+        }
+        sum = btree_sum(sum, mp->bm_base + BTREE_FILE_PAGE,
+                        end - BTREE_FILE_PAGE);
+        if (sum != mp->bm_file->bf_sum) {
+                errno = EBADMSG;
+                return -1;
+        }
+        return 0;
+}
+
+/**
+ * get a node of a mapped btree (for internal use only):
+ *
+ * args:
+ *      @mp:            pointer to btree_map
+ *      @off:           offset of node
+ *      @size:          size of node
+ *
+ * ret:
+ *      @success:       pointer to node
+ *      @failure:       NULL if node lies outside the node section
+ */
+static inline const void *
+btree_map_at(const struct btree_map *mp, uint64_t off, size_t size)
+{
+        if (off < BTREE_FILE_PAGE || off % 8 != 0 ||
+            off > mp->bm_file->bf_nodes ||
+            size > mp->bm_file->bf_nodes - off)
+                return NULL;
+        return mp->bm_base + off;
+}
+
+/**
+ * unmap a saved btree:
+ *
+ * args:
+ *      @mp:            pointer to btree_map
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static inline void
+btree_map_close(struct btree_map *mp)
+{
+        munmap(mp->bm_base, mp->bm_size);
+        mp->bm_base = NULL;
+        mp->bm_size = 0;
+        mp->bm_file = NULL;
+        mp->bm_heap = NULL;
+        mp->bm_heap_len = 0;
+}
+
+/* is x a nul-terminated string? */
+#define BTREE_IS_CSTR(x)                                                \
+        _Generic((x), char *: true, const char *: true, default: false)
+
+/* is x a pointer? (its address would mean nothing to other processes) */
+#if defined(__GNUC__)
+#define BTREE_IS_POINTER(x)     (__builtin_classify_type(x) == 5)
+#else
+#define BTREE_IS_POINTER(x)     false
+#endif
+
+/**
+ * encode a nul-terminated string for saving (bytes go to the heap):
+ *
+ * args:
+ *      @dst:           where to store encoded char pointer
+ *      @src:           pointer to char pointer to encode
+ *      @hp:            pointer to btree_heap
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_cstr_store(void *dst, const void *src, struct btree_heap *hp)
+{
+        const char *s = NULL;
+        size_t off = 0;
+
+        memcpy(&s, src, sizeof(s));
+        off = btree_heap_add(hp, s, strlen(s) + 1);
+        if (off == SIZE_MAX)
+                return -1;
+        s = (const char *)(uintptr_t)off;
+        memcpy(dst, &s, sizeof(s));
+        return 0;
+}
+
+/**
+ * decode a saved nul-terminated string in place (points into the
+ * mapping):
+ *
+ * args:
+ *      @ep:            pointer to encoded char pointer
+ *      @heap:          heap of saved btree
+ *      @len:           size of heap
+ *
+ * ret:
+ *      @success:       true
+ *      @failure:       false if string does not end inside the heap
+ */
+static inline bool
+btree_cstr_load(void *ep, const char *heap, size_t len)
+{
+        const char *s = NULL;
+        uintptr_t off = 0;
+
+        memcpy(&off, ep, sizeof(off));
+        /* btree_cstr_store always saves the nul */
+        if (off >= len || memchr(heap + off, '\0', len - off) == NULL)
+                return false;
+        s = heap + off;
+        memcpy(ep, &s, sizeof(s));
+        return true;
+}
+
+/**
+ * define store and load functions that save elements byte for byte,
+ * except char * strings, which are saved in the heap:
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type (other pointers make KEY ## _store
+ *                      fail with EINVAL, and structs must not hold
+ *                      pointers)
+ *      @KEY:           prefix of functions (KEY ## _store, KEY ## _load)
+ *
+ * ret:
+ *      @success:       generated functions
+ *      @failure:       does not fail
+ */
+#define BTREE_RAW_DEFINE(LINKAGE, TYPE, KEY)                            \
+                                                                        \
+/**                                                                     \
+ * encode an element for saving:                                        \
+ *                                                                      \
+ * args:                                                                \
+ *      @dst:           where to store encoded element                  \
+ *      @src:           element to encode                               \
+ *      @hp:            pointer to btree_heap for out of line data      \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+KEY ## _store(TYPE *dst, TYPE src, struct btree_heap *hp)               \
+{                                                                       \
+        if (BTREE_IS_CSTR(src))                                         \
+                return btree_cstr_store(dst, &src, hp);                 \
+        if (BTREE_IS_POINTER(src)) {                                    \
+                errno = EINVAL;                                         \
+                return -1;                                              \
+        }                                                               \
+        *dst = src;                                                     \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * decode a saved element:                                              \
+ *                                                                      \
+ * args:                                                                \
+ *      @e:             encoded element                                 \
+ *      @heap:          heap of saved btree                             \
+ *      @len:           size of heap                                    \
+ *      @out:           where to store decoded element                  \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true                                            \
+ *      @failure:       false if element points outside the heap        \
+ */                                                                     \
+LINKAGE bool                                                            \
+KEY ## _load(TYPE e, const char *heap, size_t len, TYPE *out)           \
+{                                                                       \
+        if (BTREE_IS_CSTR(e) && !btree_cstr_load(&e, heap, len))        \
+                return false;                                           \
+        *out = e;                                                       \
+        return true;                                                    \
+}
+
+/* number of elements under which kernels stop bisecting and count */
+#define BTREE_KERNEL_WINDOW     32
+
+/**
+ * count int32_t elements below a key (for internal use only):
+ *
+ * args:
+ *      @arr:           sorted elements
+ *      @n:             number of elements
+ *      @key:           key to compare against
+ *      @eq:            also count elements equal to key?
+ *
+ * ret:
+ *      @success:       number of elements < key (<= key if eq)
+ *      @failure:       does not fail
+ */
+static inline int
+btree_i32_count(const int32_t *arr, int n, int32_t key, bool eq)
+{
+        int c = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        __m256i k = _mm256_set1_epi32(key);
+        __m256i v;
+
+        for (; i + 8 <= n; i += 8) {
+                v = _mm256_loadu_si256((const __m256i *)(arr + i));
+                if (eq) {
+                        v = _mm256_cmpgt_epi32(v, k);
+                        c += 8 - __builtin_popcount(
+                                _mm256_movemask_ps(_mm256_castsi256_ps(v)));
+                } else {
+                        v = _mm256_cmpgt_epi32(k, v);
+                        c += __builtin_popcount(
+                                _mm256_movemask_ps(_mm256_castsi256_ps(v)));
+                }
+        }
+#elif defined(__SSE2__)
+        __m128i k = _mm_set1_epi32(key);
+        __m128i v;
+
+        for (; i + 4 <= n; i += 4) {
+                v = _mm_loadu_si128((const __m128i *)(arr + i));
+                if (eq) {
+                        v = _mm_cmpgt_epi32(v, k);
+                        c += 4 - __builtin_popcount(
+                                _mm_movemask_ps(_mm_castsi128_ps(v)));
+                } else {
+                        v = _mm_cmpgt_epi32(k, v);
+                        c += __builtin_popcount(
+                                _mm_movemask_ps(_mm_castsi128_ps(v)));
+                }
+        }
+#endif
+        for (; i < n; i++)
+                c += eq ? arr[i] <= key : arr[i] < key;
+        return c;
+}
+
+/**
+ * count int64_t elements below a key (for internal use only):
+ *
+ * args:
+ *      @arr:           sorted elements
+ *      @n:             number of elements
+ *      @key:           key to compare against
+ *      @eq:            also count elements equal to key?
+ *
+ * ret:
+ *      @success:       number of elements < key (<= key if eq)
+ *      @failure:       does not fail
+ */
+static inline int
+btree_i64_count(const int64_t *arr, int n, int64_t key, bool eq)
+{
+        int c = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        __m256i k = _mm256_set1_epi64x(key);
+        __m256i v;
+
+        for (; i + 4 <= n; i += 4) {
+                v = _mm256_loadu_si256((const __m256i *)(arr + i));
+                if (eq) {
+                        v = _mm256_cmpgt_epi64(v, k);
+                        c += 4 - __builtin_popcount(
+                                _mm256_movemask_pd(_mm256_castsi256_pd(v)));
+                } else {
+                        v = _mm256_cmpgt_epi64(k, v);
+                        c += __builtin_popcount(
+                                _mm256_movemask_pd(_mm256_castsi256_pd(v)));
+                }
+        }
+#elif defined(__SSE4_2__)
+        __m128i k = _mm_set1_epi64x(key);
+        __m128i v;
+
+        for (; i + 2 <= n; i += 2) {
+                v = _mm_loadu_si128((const __m128i *)(arr + i));
+                if (eq) {
+                        v = _mm_cmpgt_epi64(v, k);
+                        c += 2 - __builtin_popcount(
+                                _mm_movemask_pd(_mm_castsi128_pd(v)));
+                } else {
+                        v = _mm_cmpgt_epi64(k, v);
+                        c += __builtin_popcount(
+                                _mm_movemask_pd(_mm_castsi128_pd(v)));
+                }
+        }
+#endif
+        for (; i < n; i++)
+                c += eq ? arr[i] <= key : arr[i] < key;
+        return c;
+}
+
+/**
+ * count float elements below a key (for internal use only):
+ *
+ * args:
+ *      @arr:           sorted elements
+ *      @n:             number of elements
+ *      @key:           key to compare against
+ *      @eq:            also count elements equal to key?
+ *
+ * ret:
+ *      @success:       number of elements < key (<= key if eq)
+ *      @failure:       does not fail
+ */
+static inline int
+btree_f32_count(const float *arr, int n, float key, bool eq)
+{
+        int c = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        __m256 k = _mm256_set1_ps(key);
+        __m256 v;
+
+        for (; i + 8 <= n; i += 8) {
+                v = _mm256_loadu_ps(arr + i);
+                if (eq)
+                        v = _mm256_cmp_ps(v, k, _CMP_LE_OQ);
+                else
+                        v = _mm256_cmp_ps(v, k, _CMP_LT_OQ);
+                c += __builtin_popcount(_mm256_movemask_ps(v));
+        }
+#elif defined(__SSE2__)
+        __m128 k = _mm_set1_ps(key);
+        __m128 v;
+
+        for (; i + 4 <= n; i += 4) {
+                v = _mm_loadu_ps(arr + i);
+                if (eq)
+                        v = _mm_cmple_ps(v, k);
+                else
+                        v = _mm_cmplt_ps(v, k);
+                c += __builtin_popcount(_mm_movemask_ps(v));
+        }
+#endif
+        for (; i < n; i++)
+                c += eq ? arr[i] <= key : arr[i] < key;
+        return c;
+}
+
+/**
+ * count double elements below a key (for internal use only):
+ *
+ * args:
+ *      @arr:           sorted elements
+ *      @n:             number of elements
+ *      @key:           key to compare against
+ *      @eq:            also count elements equal to key?
+ *
+ * ret:
+ *      @success:       number of elements < key (<= key if eq)
+ *      @failure:       does not fail
+ */
+static inline int
+btree_f64_count(const double *arr, int n, double key, bool eq)
+{
+        int c = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        __m256d k = _mm256_set1_pd(key);
+        __m256d v;
+
+        for (; i + 4 <= n; i += 4) {
+                v = _mm256_loadu_pd(arr + i);
+                if (eq)
+                        v = _mm256_cmp_pd(v, k, _CMP_LE_OQ);
+                else
+                        v = _mm256_cmp_pd(v, k, _CMP_LT_OQ);
+                c += __builtin_popcount(_mm256_movemask_pd(v));
+        }
+#elif defined(__SSE2__)
+        __m128d k = _mm_set1_pd(key);
+        __m128d v;
+
+        for (; i + 2 <= n; i += 2) {
+                v = _mm_loadu_pd(arr + i);
+                if (eq)
+                        v = _mm_cmple_pd(v, k);
+                else
+                        v = _mm_cmplt_pd(v, k);
+                c += __builtin_popcount(_mm_movemask_pd(v));
+        }
+#endif
+        for (; i < n; i++)
+                c += eq ? arr[i] <= key : arr[i] < key;
+        return c;
+}
+
+/**
+ * define lower and upper bound kernels for a scalar key type:
+ *
+ * args:
+ *      @TYPE:          scalar key type
+ *      @KEY:           prefix of kernels (KEY ## _count must exist)
+ *
+ * ret:
+ *      @success:       KEY ## _lower, KEY ## _upper, KEY ## _store and
+ *                      KEY ## _load
+ *      @failure:       does not fail
+ */
+#define BTREE_KERNEL_DEFINE(TYPE, KEY)                                  \
+                                                                        \
+/**                                                                     \
+ * find bound of key in sorted elements (for internal use only):        \
+ *                                                                      \
+ * args:                                                                \
+ *      @arr:           sorted elements                                 \
+ *      @n:             number of elements                              \
+ *      @key:           key to search for                               \
+ *      @eq:            upper bound instead of lower bound?             \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       index of first element >= key (> key if eq)     \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+static inline int                                                       \
+KEY ## _bound(const TYPE *arr, int n, TYPE key, bool eq)                \
+{                                                                       \
+        const TYPE *base = arr;                                         \
+        int half = 0;                                                   \
+                                                                        \
+        /* bisect without branching until counting is cheaper */        \
+        while (n > BTREE_KERNEL_WINDOW) {                               \
+                half = n >> 1;                                          \
+                base = (eq ? base[half] <= key : base[half] < key) ?    \
+                       base + half : base;                              \
+                n -= half;                                              \
+        }                                                               \
+                                                                        \
+        return (int)(base - arr) + KEY ## _count(base, n, key, eq);     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find first element not less than key:                                \
+ *                                                                      \
+ * args:                                                                \
+ *      @arr:           sorted elements                                 \
+ *      @n:             number of elements                              \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       index of first element >= key                   \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+static inline int                                                       \
+KEY ## _lower(const TYPE *arr, int n, TYPE key)                         \
+{                                                                       \
+        return KEY ## _bound(arr, n, key, false);                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find first element greater than key:                                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @arr:           sorted elements                                 \
+ *      @n:             number of elements                              \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       index of first element > key                    \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+static inline int                                                       \
+KEY ## _upper(const TYPE *arr, int n, TYPE key)                         \
+{                                                                       \
+        return KEY ## _bound(arr, n, key, true);                        \
+}                                                                       \
+                                                                        \
+BTREE_RAW_DEFINE(static inline, TYPE, KEY)
+
+BTREE_KERNEL_DEFINE(int32_t, btree_i32)
+BTREE_KERNEL_DEFINE(int64_t, btree_i64)
+BTREE_KERNEL_DEFINE(float, btree_f32)
+BTREE_KERNEL_DEFINE(double, btree_f64)
+
+/* string key with its first bytes cached inline */
+struct btree_str {
+        /* first 8 bytes, big-endian and zero padded */
+        uint64_t                bs_pfx;
+        /* length of string */
+        size_t                  bs_len;
+        /* string (need not be nul terminated) */
+        char                    *bs_ptr;
+};
+
+/**
+ * make a btree_str:
+ *
+ * args:
+ *      @s:             pointer to string
+ *      @len:           length of string
+ *
+ * ret:
+ *      @success:       btree_str for s
+ *      @failure:       does not fail
+ */
+static inline struct btree_str
+btree_str_make(char *s, size_t len)
+{
+        struct btree_str str = {0};
+        size_t i = 0;
+
+        /* big-endian so integer order matches memcmp order */
+        for (i = 0; i < sizeof(str.bs_pfx); i++) {
+                str.bs_pfx <<= 8;
+                if (i < len)
+                        str.bs_pfx |= (unsigned char)s[i];
+        }
+
+        str.bs_len = len;
+        str.bs_ptr = s;
+        return str;
+}
+
+/**
+ * compare two btree_strs:
+ *
+ * args:
+ *      @a:             first btree_str
+ *      @b:             second btree_str
+ *
+ * ret:
+ *      @success:       < 0, 0 or > 0 as a sorts before, with or after b
+ *      @failure:       does not fail
+ */
+static inline int
+btree_str_cmp(struct btree_str a, struct btree_str b)
+{
+        size_t n = 0;
+        int c = 0;
+
+        if (a.bs_pfx != b.bs_pfx)
+                return a.bs_pfx < b.bs_pfx ? -1 : 1;
+
+        /* only touch the strings themselves on a prefix tie */
+        n = a.bs_len < b.bs_len ? a.bs_len : b.bs_len;
+        if (n > sizeof(a.bs_pfx)) {
+                c = memcmp(a.bs_ptr + sizeof(a.bs_pfx),
+                           b.bs_ptr + sizeof(b.bs_pfx),
+                           n - sizeof(a.bs_pfx));
+                if (c != 0)
+                        return c;
+        }
+
+        return (a.bs_len > b.bs_len) - (a.bs_len < b.bs_len);
+}
+
+/**
+ * loop over every element of a btree without indirect calls:
+ *
+ * args:
+ *      @NAME:          name of btree struct
+ *      @cp:            pointer to NAME ## _cursor
+ *      @bp:            pointer to NAME
+ *      @ep:            TYPE pointer set to each element in turn
+ *
+ * ret:
+ *      @success:       for loop header
+ *      @failure:       does not fail
+ */
+#define BTREE_FOREACH(NAME, cp, bp, ep)                                 \
+        for (NAME ## _cursor_first((cp), (bp));                         \
+             ((ep) = NAME ## _cursor_get(cp)) != NULL;                  \
+             NAME ## _cursor_next(cp))
+
+/**
+ * loop over the elements of a btree in [lo, hi] without indirect calls:
+ *
+ * args:
+ *      @NAME:          name of btree struct
+ *      @cp:            pointer to NAME ## _cursor
+ *      @bp:            pointer to NAME
+ *      @lo:            lowest element to visit
+ *      @hi:            highest element to visit
+ *      @ep:            TYPE pointer set to each element in turn
+ *
+ * ret:
+ *      @success:       for loop header
+ *      @failure:       does not fail
+ */
+#define BTREE_FOREACH_RANGE(NAME, cp, bp, lo, hi, ep)                   \
+        for (NAME ## _range((cp), (bp), (lo), (hi));                    \
+             ((ep) = NAME ## _cursor_get(cp)) != NULL;                  \
+             NAME ## _cursor_next(cp))
+
+/**
+ * define lower and upper bound kernels that binary search with CMP_FN:
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @CMP_FN:        element comparison function
+ *      @KEY:           prefix of kernels (KEY ## _lower, KEY ## _upper)
+ *
+ * ret:
+ *      @success:       generated kernels
+ *      @failure:       does not fail
+ */
+#define BTREE_KEY_DEFINE(LINKAGE, TYPE, CMP_FN, KEY)                    \
+                                                                        \
+/**                                                                     \
+ * find first element not less than key:                                \
+ *                                                                      \
+ * args:                                                                \
+ *      @arr:           sorted elements                                 \
+ *      @n:             number of elements                              \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       index of first element >= key                   \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE int                                                             \
+KEY ## _lower(TYPE *arr, int n, TYPE key)                               \
+{                                                                       \
+        TYPE *base = arr;                                               \
+        int half = 0;                                                   \
+                                                                        \
+        if (n == 0)                                                     \
+                return 0;                                               \
+                                                                        \
+        /* simple enough for the compiler to use a conditional move */  \
+        while (n > 1) {                                                 \
+                half = n >> 1;                                          \
+                if (CMP_FN(base[half], key) < 0)                        \
+                        base += half;                                   \
+                n -= half;                                              \
+        }                                                               \
+                                                                        \
+        return (int)(base - arr) + (CMP_FN(*base, key) < 0);            \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find first element greater than key:                                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @arr:           sorted elements                                 \
+ *      @n:             number of elements                              \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       index of first element > key                    \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE int                                                             \
+KEY ## _upper(TYPE *arr, int n, TYPE key)                               \
+{                                                                       \
+        TYPE *base = arr;                                               \
+        int half = 0;                                                   \
+                                                                        \
+        if (n == 0)                                                     \
+                return 0;                                               \
+                                                                        \
+        while (n > 1) {                                                 \
+                half = n >> 1;                                          \
+                if (CMP_FN(base[half], key) <= 0)                       \
+                        base += half;                                   \
+                n -= half;                                              \
+        }                                                               \
+                                                                        \
+        return (int)(base - arr) + (CMP_FN(*base, key) <= 0);           \
+}
+
+BTREE_KEY_DEFINE(static inline, struct btree_str, btree_str_cmp, btree_str)
+
+/**
+ * encode a btree_str for saving (bytes go to the heap):
+ *
+ * args:
+ *      @dst:           where to store encoded btree_str
+ *      @src:           btree_str to encode
+ *      @hp:            pointer to btree_heap
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static inline int
+btree_str_store(struct btree_str *dst, struct btree_str src,
+                struct btree_heap *hp)
+{
+        size_t off = btree_heap_add(hp, src.bs_ptr, src.bs_len);
+
+        if (off == SIZE_MAX)
+                return -1;
+        dst->bs_pfx = src.bs_pfx;
+        dst->bs_len = src.bs_len;
+        dst->bs_ptr = (char *)(uintptr_t)off;
+        return 0;
+}
+
+/**
+ * decode a saved btree_str (points into the mapping, nothing is copied):
+ *
+ * args:
+ *      @e:             encoded btree_str
+ *      @heap:          heap of saved btree
+ *      @len:           size of heap
+ *      @out:           where to store decoded btree_str
+ *
+ * ret:
+ *      @success:       true
+ *      @failure:       false if bytes lie outside the heap
+ */
+static inline bool
+btree_str_load(struct btree_str e, const char *heap, size_t len,
+               struct btree_str *out)
+{
+        uintptr_t off = (uintptr_t)e.bs_ptr;
+
+        if (off > len || e.bs_len > len - off)
+                return false;
+        e.bs_ptr = (char *)heap + off;
+        *out = e;
+        return true;
+}
+
+/* event counts of a btree (all 0 unless BTREE_COUNTERS is defined) */
+struct btree_counters {
+        /* node splits */
+        size_t                  bt_splits;
+        /* calls to CMP_FN */
+        size_t                  bt_cmps;
+        /* nodes allocated */
+        size_t                  bt_allocs;
+};
+
+#ifdef BTREE_COUNTERS
+/* bump a counter of a btree called NAME (not atomic) */
+#define BTREE_COUNT(NAME, field)        ((void)NAME ## _counters.field++)
+/* copy counters of a btree called NAME */
+#define BTREE_COUNTERS_GET(NAME, cp)    (*(cp) = NAME ## _counters)
+/* zero counters of a btree called NAME */
+#define BTREE_COUNTERS_RESET(NAME)                                      \
+        memset(&NAME ## _counters, 0, sizeof(NAME ## _counters))
+/* counters of a btree called NAME */
+#define BTREE_COUNTERS_DECLARE(NAME)                                    \
+        static struct btree_counters NAME ## _counters;
+#else
+#define BTREE_COUNT(NAME, field)        ((void)0)
+#define BTREE_COUNTERS_GET(NAME, cp)    memset((cp), 0, sizeof(*(cp)))
+#define BTREE_COUNTERS_RESET(NAME)      ((void)0)
+#define BTREE_COUNTERS_DECLARE(NAME)
+#endif
+
+/**
+ * define the comparison function a btree calls CMP_FN through:
+ *
+ * args:
+ *      @TYPE:          element type
+ *      @CMP_FN:        element comparison function
+ *      @NAME:          name of btree struct
+ *
+ * ret:
+ *      @success:       NAME ## _cmp and counters of NAME
+ *      @failure:       does not fail
+ */
+#define BTREE_CMP_DEFINE(TYPE, CMP_FN, NAME)                            \
+                                                                        \
+BTREE_COUNTERS_DECLARE(NAME)                                            \
+                                                                        \
+/**                                                                     \
+ * compare two NAME elements (for internal use only):                   \
+ *                                                                      \
+ * args:                                                                \
+ *      @a:             first element                                   \
+ *      @b:             second element                                  \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       CMP_FN of elements                              \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+static inline int                                                       \
+NAME ## _cmp(TYPE a, TYPE b)                                            \
+{                                                                       \
+        BTREE_COUNT(NAME, bt_cmps);                                     \
+        return CMP_FN(a, b);                                            \
+}
+
+/**
+ * define a new btree:
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @CMP_FN:        element comparison function
+ *      @NAME:          name of generated struct
+ *
+ * ret:
+ *      @success:       generated btree struct and functions
+ *      @failure:       does not fail
+ */
+#define BTREE_DEFINE(LINKAGE, TYPE, DEGREE, CMP_FN, NAME)               \
+        BTREE_CMP_DEFINE(TYPE, CMP_FN, NAME)                            \
+        BTREE_KEY_DEFINE(LINKAGE, TYPE, NAME ## _cmp, NAME ## _key)     \
+        BTREE_RAW_DEFINE(LINKAGE, TYPE, NAME ## _key)                   \
+        BTREE_DEFINE_TREE(LINKAGE, TYPE, DEGREE, NAME, NAME ## _key, 0)
+
+/**
+ * define a new btree with its own in-node search kernels:
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @CMP_FN:        element comparison function
+ *      @NAME:          name of generated struct
+ *      @KEY:           prefix of KEY ## _lower and KEY ## _upper, which
+ *                      must order elements the same way as CMP_FN
+ *                      (btree_i32, btree_i64, btree_f32 and btree_f64
+ *                      are SIMD kernels for scalar keys, and
+ *                      BTREE_KEY_DEFINE makes branch-free binary
+ *                      search kernels from CMP_FN), and of KEY ## _store
+ *                      and KEY ## _load, which encode elements for
+ *                      NAME ## _save and must reject encoded elements
+ *                      that point outside the heap (BTREE_RAW_DEFINE
+ *                      copies them as is but keeps char * strings in
+ *                      the heap, btree_str keeps its bytes in the heap)
+ *
+ * ret:
+ *      @success:       generated btree struct and functions
+ *      @failure:       does not fail
+ */
+#define BTREE_DEFINE_KEY(LINKAGE, TYPE, DEGREE, CMP_FN, NAME, KEY)      \
+        BTREE_CMP_DEFINE(TYPE, CMP_FN, NAME)                            \
+        BTREE_DEFINE_TREE(LINKAGE, TYPE, DEGREE, NAME, KEY, 0)
+
+/**
+ * define a new btree that also answers rank and select queries:
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @CMP_FN:        element comparison function
+ *      @NAME:          name of generated struct
+ *
+ * ret:
+ *      @success:       everything BTREE_DEFINE generates, plus
+ *                      NAME ## _rank, NAME ## _select and
+ *                      NAME ## _count_range
+ *      @failure:       does not fail
+ */
+#define BTREE_RANKED_DEFINE(LINKAGE, TYPE, DEGREE, CMP_FN, NAME)        \
+        BTREE_CMP_DEFINE(TYPE, CMP_FN, NAME)                            \
+        BTREE_KEY_DEFINE(LINKAGE, TYPE, NAME ## _cmp, NAME ## _key)     \
+        BTREE_RAW_DEFINE(LINKAGE, TYPE, NAME ## _key)                   \
+        BTREE_DEFINE_TREE(LINKAGE, TYPE, DEGREE, NAME, NAME ## _key, 1) \
+        BTREE_RANK_DEFINE(LINKAGE, TYPE, NAME, NAME ## _key)
+
+/**
+ * define a new btree with its own in-node search kernels that also
+ * answers rank and select queries:
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @CMP_FN:        element comparison function
+ *      @NAME:          name of generated struct
+ *      @KEY:           prefix of kernels (see BTREE_DEFINE_KEY)
+ *
+ * ret:
+ *      @success:       everything BTREE_DEFINE_KEY generates, plus
+ *                      NAME ## _rank, NAME ## _select and
+ *                      NAME ## _count_range
+ *      @failure:       does not fail
+ */
+#define BTREE_RANKED_DEFINE_KEY(LINKAGE, TYPE, DEGREE, CMP_FN, NAME,    \
+                                KEY)                                    \
+        BTREE_CMP_DEFINE(TYPE, CMP_FN, NAME)                            \
+        BTREE_DEFINE_TREE(LINKAGE, TYPE, DEGREE, NAME, KEY, 1)          \
+        BTREE_RANK_DEFINE(LINKAGE, TYPE, NAME, KEY)
+
+/**
+ * define btree struct and functions (for internal use only):
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @NAME:          name of generated struct (NAME ## _cmp must exist)
+ *      @KEY:           prefix of search kernels and element encoders
+ *      @RANKED:        1 to keep subtree sizes in internal nodes, else 0
+ *
+ * ret:
+ *      @success:       generated btree struct and functions
+ *      @failure:       does not fail
+ */
+#define BTREE_DEFINE_TREE(LINKAGE, TYPE, DEGREE, NAME, KEY, RANKED)     \
+                                                                        \
+/* btree node (all of a leaf, and the head of an internal node) */      \
+struct NAME ## _node {                                                  \
+        /* number of keys in node */                                    \
+        int                     bn_len;                                 \
+        /* is this node a leaf? */                                      \
+        bool                    bn_leaf;                                \
+        /* elements */                                                  \
+        TYPE                    bn_elem[(DEGREE << 1) - 1];             \
+};                                                                      \
+                                                                        \
+/* internal btree node */                                               \
+struct NAME ## _inode {                                                 \
+        /* header and elements */                                       \
+        struct NAME ## _node    bi_node;                                \
+        /* array of pointers to children */                             \
+        struct NAME ## _node    *bi_kids[(DEGREE << 1)];                \
+};                                                                      \
+                                                                        \
+/* internal node of a RANKED btree (unranked ones never allocate it) */ \
+struct NAME ## _rinode {                                                \
+        /* header, elements and children */                             \
+        struct NAME ## _inode   ri_inode;                               \
+        /* elements under each child */                                 \
+        size_t                  ri_sizes[(DEGREE << 1)];                \
+};                                                                      \
+                                                                        \
+/* internal btree node as saved to a file */                            \
+struct NAME ## _dinode {                                                \
+        /* header and encoded elements */                               \
+        struct NAME ## _node    di_node;                                \
+        /* file offsets of children */                                  \
+        uint64_t                di_kids[(DEGREE << 1)];                 \
+};                                                                      \
+                                                                        \
+/* btree */                                                             \
+struct NAME {                                                           \
+        /* root node of btree */                                        \
+        struct NAME ## _node    *b_root;                                \
+        /* number of elements */                                        \
+        size_t                  b_size;                                 \
+        /* leaf pool (pl_size is 0 if nodes come from malloc) */        \
+        struct btree_pool       b_pool;                                 \
+        /* internal node pool */                                        \
+        struct btree_pool       b_ipool;                                \
+        /* node allocator (ba_alloc is NULL for malloc) */              \
+        struct btree_alloc      b_alloc;                                \
+};                                                                      \
+                                                                        \
+/* btree cursor */                                                      \
+struct NAME ## _cursor {                                                \
+        /* btree being walked */                                        \
+        struct NAME             *bc_tree;                               \
+        /* nodes on path from root */                                   \
+        struct NAME ## _node    *bc_node[BTREE_MAX_HEIGHT];             \
+        /* index into each node on path */                              \
+        int                     bc_idx[BTREE_MAX_HEIGHT];               \
+        /* depth of current node (-1 at end) */                         \
+        int                     bc_depth;                               \
+        /* does cursor stop outside [bc_lo, bc_hi]? */                  \
+        bool                    bc_ranged;                              \
+        /* lowest element of range */                                   \
+        TYPE                    bc_lo;                                  \
+        /* highest element of range */                                  \
+        TYPE                    bc_hi;                                  \
+};                                                                      \
+                                                                        \
+/* shape, fill and memory use of a btree */                             \
+struct NAME ## _stats {                                                 \
+        /* nodes on each level (level 0 is the root) */                 \
+        size_t                  st_level[BTREE_MAX_HEIGHT];             \
+        /* number of levels (0 if empty) */                             \
+        int                     st_height;                              \
+        /* number of leaves */                                          \
+        size_t                  st_leaves;                              \
+        /* number of internal nodes */                                  \
+        size_t                  st_inodes;                              \
+        /* number of elements */                                        \
+        size_t                  st_count;                               \
+        /* bytes held by NAME and its nodes (or its pool chunks) */     \
+        size_t                  st_bytes;                               \
+        /* average elements per node over most a node can hold */       \
+        double                  st_fill;                                \
+        /* fewest elements in a node other than the root */             \
+        int                     st_min_len;                             \
+        /* st_min_len over most a node can hold */                      \
+        double                  st_min_fill;                            \
+        /* event counts (all 0 unless BTREE_COUNTERS is defined) */     \
+        struct btree_counters   st_counters;                            \
+};                                                                      \
+                                                                        \
+/**                                                                     \
+ * initialize a NAME:                                                   \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _init(struct NAME *bp)                                          \
+{                                                                       \
+        bp->b_root = NULL;                                              \
+        bp->b_size = 0;                                                 \
+        btree_pool_init(&bp->b_pool, 0);                                \
+        btree_pool_init(&bp->b_ipool, 0);                               \
+        memset(&bp->b_alloc, 0, sizeof(bp->b_alloc));                   \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * initialize a NAME that allocates its nodes from a pool:              \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _init_pool(struct NAME *bp)                                     \
+{                                                                       \
+        bp->b_root = NULL;                                              \
+        bp->b_size = 0;                                                 \
+        btree_pool_init(&bp->b_pool, sizeof(struct NAME ## _node));     \
+        btree_pool_init(&bp->b_ipool, BTREE_INODE_SIZE(NAME, RANKED));  \
+        memset(&bp->b_alloc, 0, sizeof(bp->b_alloc));                   \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * initialize a NAME that gets its nodes from a caller's allocator:     \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @ap:            pointer to btree_alloc (copied, and both        \
+ *                      ba_alloc and ba_free must be set)               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _init_alloc(struct NAME *bp, const struct btree_alloc *ap)      \
+{                                                                       \
+        bp->b_root = NULL;                                              \
+        bp->b_size = 0;                                                 \
+        btree_pool_init(&bp->b_pool, 0);                                \
+        btree_pool_init(&bp->b_ipool, 0);                               \
+        bp->b_alloc = *ap;                                              \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * create a new NAME ## _node (for internal use only):                  \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @leaf:          is this node a leaf?                            \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to new NAME ## _node                    \
+ *      @failure:       NULL and errno set                              \
+ */                                                                     \
+LINKAGE struct NAME ## _node *                                          \
+NAME ## _node_new(struct NAME *bp, bool leaf)                           \
+{                                                                       \
+        struct btree_pool *pp = leaf ? &bp->b_pool : &bp->b_ipool;      \
+        size_t size = leaf ? sizeof(struct NAME ## _node) :             \
+                             BTREE_INODE_SIZE(NAME, RANKED);            \
+        struct NAME ## _node *np = NULL;                                \
+                                                                        \
+        if (pp->pl_size != 0)                                           \
+                np = btree_pool_get(pp);                                \
+        else if (bp->b_alloc.ba_alloc != NULL)                          \
+                np = bp->b_alloc.ba_alloc(bp->b_alloc.ba_ctx, size);    \
+        else                                                            \
+                np = malloc(size);                                      \
+        if (np == NULL)                                                 \
+                return NULL;                                            \
+                                                                        \
+        BTREE_COUNT(NAME, bt_allocs);                                   \
+        np->bn_leaf = leaf;                                             \
+        np->bn_len = 0;                                                 \
+        return np;                                                      \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * release a single NAME ## _node (for internal use only):              \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @np:            pointer to NAME ## _node                        \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _node_release(struct NAME *bp, struct NAME ## _node *np)        \
+{                                                                       \
+        size_t size = np->bn_leaf ? sizeof(struct NAME ## _node) :      \
+                                    BTREE_INODE_SIZE(NAME, RANKED);     \
+                                                                        \
+        if (bp->b_alloc.ba_free != NULL)                                \
+                bp->b_alloc.ba_free(bp->b_alloc.ba_ctx, np, size);      \
+        else if (bp->b_pool.pl_size == 0)                               \
+                free(np);                                               \
+        else if (np->bn_leaf)                                           \
+                btree_pool_put(&bp->b_pool, np);                        \
+        else                                                            \
+                btree_pool_put(&bp->b_ipool, np);                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * count elements under a NAME ## _node of a RANKED NAME                \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @np:            pointer to NAME ## _node                        \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       number of elements in node and its subtree      \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE size_t                                                          \
+NAME ## _node_size(struct NAME ## _node *np)                            \
+{                                                                       \
+        size_t size = (size_t)np->bn_len;                               \
+        int i = -1;                                                     \
+                                                                        \
+        if (!np->bn_leaf) {                                             \
+                for (i = 0; i <= np->bn_len; i++)                       \
+                        size += BTREE_SIZES(NAME, np)[i];               \
+        }                                                               \
+        return size;                                                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * recount subtree sizes of an internal NAME ## _node of a RANKED NAME  \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @np:            pointer to internal NAME ## _node               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _node_resize(struct NAME ## _node *np)                          \
+{                                                                       \
+        int i = -1;                                                     \
+                                                                        \
+        for (i = 0; i <= np->bn_len; i++) {                             \
+                BTREE_SIZES(NAME, np)[i] =                              \
+                        NAME ## _node_size(BTREE_KIDS(NAME, np)[i]);    \
+        }                                                               \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * split a NAME ## _node (for internal use only):                       \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @kid:           kid to split                                    \
+ *      @idx:           index to split on                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _node_split(struct NAME *bp,                                    \
+                    struct NAME ## _node *np,                           \
+                    struct NAME ## _node *kid,                          \
+                    int idx)                                            \
+{                                                                       \
+        struct NAME ## _node *new = NULL;                               \
+        int i = -1;                                                     \
+                                                                        \
+        new = NAME ## _node_new(bp, kid->bn_leaf);                      \
+        if (new == NULL)                                                \
+                return -1;                                              \
+                                                                        \
+        BTREE_COUNT(NAME, bt_splits);                                   \
+        new->bn_len = DEGREE - 1;                                       \
+        for (i = 0; i < (DEGREE - 1); i++)                              \
+                new->bn_elem[i] = kid->bn_elem[DEGREE + i];             \
+        if (!kid->bn_leaf) {                                            \
+                for (i = 0; i < DEGREE; i++) {                          \
+                        BTREE_KIDS(NAME, new)[i] =                      \
+                                BTREE_KIDS(NAME, kid)[DEGREE + i];      \
+                }                                                       \
+                if (RANKED) {                                           \
+                        memcpy(BTREE_SIZES(NAME, new),                  \
+                               BTREE_SIZES(NAME, kid) + DEGREE,         \
+                               DEGREE * sizeof(size_t));                \
+                }                                                       \
+        }                                                               \
+        kid->bn_len = DEGREE - 1;                                       \
+                                                                        \
+        for (i = np->bn_len; i >= idx + 1; i--)                         \
+                BTREE_KIDS(NAME, np)[i + 1] = BTREE_KIDS(NAME, np)[i];  \
+        BTREE_KIDS(NAME, np)[idx + 1] = new;                            \
+        if (RANKED) {                                                   \
+                for (i = np->bn_len; i >= idx + 1; i--) {               \
+                        BTREE_SIZES(NAME, np)[i + 1] =                  \
+                                BTREE_SIZES(NAME, np)[i];               \
+                }                                                       \
+                BTREE_SIZES(NAME, np)[idx] = NAME ## _node_size(kid);   \
+                BTREE_SIZES(NAME, np)[idx + 1] =                        \
+                        NAME ## _node_size(new);                        \
+        }                                                               \
+                                                                        \
+        for (i = np->bn_len - 1; i >= idx; i--)                         \
+                np->bn_elem[i + 1] = np->bn_elem[i];                    \
+        np->bn_elem[idx] = kid->bn_elem[DEGREE - 1];                    \
+                                                                        \
+        np->bn_len++;                                                   \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * add an element to NAME ## _node (for internal use only):             \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @elem:          element to add                                  \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _node_add(struct NAME *bp, struct NAME ## _node *np, TYPE elem) \
+{                                                                       \
+        struct NAME ## _node *kid = NULL;                               \
+        int i = -1;                                                     \
+        int j = -1;                                                     \
+                                                                        \
+        i = KEY ## _upper(np->bn_elem, np->bn_len, elem);               \
+        if (np->bn_leaf) {                                              \
+                for (j = np->bn_len; j > i; j--)                        \
+                        np->bn_elem[j] = np->bn_elem[j - 1];            \
+                np->bn_elem[i] = elem;                                  \
+                np->bn_len++;                                           \
+                return 0;                                               \
+        }                                                               \
+                                                                        \
+        if (BTREE_KIDS(NAME, np)[i]->bn_len == ((DEGREE << 1) - 1)) {   \
+                kid = BTREE_KIDS(NAME, np)[i];                          \
+                if (NAME ## _node_split(bp, np, kid, i) < 0)            \
+                        return -1;                                      \
+                if (NAME ## _cmp(np->bn_elem[i], elem) < 0)             \
+                        i++;                                            \
+        }                                                               \
+                                                                        \
+        if (NAME ## _node_add(bp, BTREE_KIDS(NAME, np)[i], elem) < 0)   \
+                return -1;                                              \
+        if (RANKED)                                                     \
+                BTREE_SIZES(NAME, np)[i]++;                             \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * split the full root of NAME (for internal use only):                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _root_split(struct NAME *bp)                                    \
+{                                                                       \
+        struct NAME ## _node *new = NULL;                               \
+                                                                        \
+        new = NAME ## _node_new(bp, false);                             \
+        if (new == NULL)                                                \
+                return -1;                                              \
+                                                                        \
+        BTREE_KIDS(NAME, new)[0] = bp->b_root;                          \
+        if (NAME ## _node_split(bp, new, bp->b_root, 0) < 0) {          \
+                NAME ## _node_release(bp, new);                         \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        bp->b_root = new;                                               \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * add element to NAME:                                                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @elem:          element to add                                  \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _add(struct NAME *bp, TYPE elem)                                \
+{                                                                       \
+        int ret = -1;                                                   \
+                                                                        \
+        if (bp->b_root == NULL) {                                       \
+                bp->b_root = NAME ## _node_new(bp, true);               \
+                if (bp->b_root == NULL)                                 \
+                        return -1;                                      \
+                bp->b_root->bn_elem[0] = elem;                          \
+                bp->b_root->bn_len = 1;                                 \
+                bp->b_size = 1;                                         \
+                return 0;                                               \
+        }                                                               \
+                                                                        \
+        if (bp->b_root->bn_len == ((DEGREE << 1) - 1) &&                \
+            NAME ## _root_split(bp) < 0)                                \
+                return -1;                                              \
+                                                                        \
+        ret = NAME ## _node_add(bp, bp->b_root, elem);                  \
+        if (ret == 0)                                                   \
+                bp->b_size++;                                           \
+        return ret;                                                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * count elements of NAME:                                              \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       number of elements                              \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE size_t                                                          \
+NAME ## _size(struct NAME *bp)                                          \
+{                                                                       \
+        return bp->b_size;                                              \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find a bound of key in NAME (for internal use only):                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *      @eq:            upper bound instead of lower bound?             \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to first element >= key (> key if eq)   \
+ *      @failure:       NULL if there is no such element                \
+ */                                                                     \
+LINKAGE TYPE *                                                          \
+NAME ## _bound(struct NAME *bp, TYPE key, bool eq)                      \
+{                                                                       \
+        struct NAME ## _node *np = bp->b_root;                          \
+        TYPE *best = NULL;                                              \
+        int i = -1;                                                     \
+                                                                        \
+        /* deeper candidates always come earlier in order */            \
+        while (np != NULL) {                                            \
+                if (eq)                                                 \
+                        i = KEY ## _upper(np->bn_elem, np->bn_len,      \
+                                          key);                         \
+                else                                                    \
+                        i = KEY ## _lower(np->bn_elem, np->bn_len,      \
+                                          key);                         \
+                if (i < np->bn_len)                                     \
+                        best = &np->bn_elem[i];                         \
+                np = np->bn_leaf ? NULL : BTREE_KIDS(NAME, np)[i];      \
+        }                                                               \
+                                                                        \
+        return best;                                                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find first element of NAME not less than key:                        \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to element (valid until next change)    \
+ *      @failure:       NULL if every element is less than key          \
+ */                                                                     \
+LINKAGE TYPE *                                                          \
+NAME ## _lower_bound(struct NAME *bp, TYPE key)                         \
+{                                                                       \
+        return NAME ## _bound(bp, key, false);                          \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find first element of NAME greater than key:                         \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to element (valid until next change)    \
+ *      @failure:       NULL if no element is greater than key          \
+ */                                                                     \
+LINKAGE TYPE *                                                          \
+NAME ## _upper_bound(struct NAME *bp, TYPE key)                         \
+{                                                                       \
+        return NAME ## _bound(bp, key, true);                           \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find element of NAME equal to key:                                   \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to element (valid until next change)    \
+ *      @failure:       NULL if key is not in NAME                      \
+ */                                                                     \
+LINKAGE TYPE *                                                          \
+NAME ## _find(struct NAME *bp, TYPE key)                                \
+{                                                                       \
+        struct NAME ## _node *np = bp->b_root;                          \
+        int i = -1;                                                     \
+                                                                        \
+        while (np != NULL) {                                            \
+                i = KEY ## _lower(np->bn_elem, np->bn_len, key);        \
+                if (i < np->bn_len &&                                   \
+                    NAME ## _cmp(np->bn_elem[i], key) == 0)             \
+                        return &np->bn_elem[i];                         \
+                np = np->bn_leaf ? NULL : BTREE_KIDS(NAME, np)[i];      \
+        }                                                               \
+                                                                        \
+        return NULL;                                                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * is key in NAME?                                                      \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if key is in NAME, false if not            \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _contains(struct NAME *bp, TYPE key)                            \
+{                                                                       \
+        return NAME ## _find(bp, key) != NULL;                          \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * walk a cursor down to the first or last element under a node         \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *      @np:            pointer to NAME ## _node (may be NULL)          \
+ *      @last:          go to last element instead of first?            \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _cursor_down(struct NAME ## _cursor *cp,                        \
+                     struct NAME ## _node *np,                          \
+                     bool last)                                         \
+{                                                                       \
+        int d = -1;                                                     \
+                                                                        \
+        while (np != NULL) {                                            \
+                d = ++cp->bc_depth;                                     \
+                cp->bc_node[d] = np;                                    \
+                if (np->bn_leaf) {                                      \
+                        cp->bc_idx[d] = last ? np->bn_len - 1 : 0;      \
+                        return;                                         \
+                }                                                       \
+                cp->bc_idx[d] = last ? np->bn_len : 0;                  \
+                np = BTREE_KIDS(NAME, np)[cp->bc_idx[d]];               \
+        }                                                               \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * pop a cursor up to the next unvisited element                        \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _cursor_up(struct NAME ## _cursor *cp)                          \
+{                                                                       \
+        int d = cp->bc_depth;                                           \
+                                                                        \
+        /* an index into an internal node names the element that */     \
+        /* comes right after the kid we went down into */               \
+        while (d >= 0 && cp->bc_idx[d] >= cp->bc_node[d]->bn_len)       \
+                d--;                                                    \
+        cp->bc_depth = d;                                               \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * point a NAME ## _cursor at first element of NAME:                    \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _cursor_first(struct NAME ## _cursor *cp, struct NAME *bp)      \
+{                                                                       \
+        cp->bc_tree = bp;                                               \
+        cp->bc_depth = -1;                                              \
+        cp->bc_ranged = false;                                          \
+        NAME ## _cursor_down(cp, bp->b_root, false);                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * point a NAME ## _cursor at last element of NAME:                     \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _cursor_last(struct NAME ## _cursor *cp, struct NAME *bp)       \
+{                                                                       \
+        cp->bc_tree = bp;                                               \
+        cp->bc_depth = -1;                                              \
+        cp->bc_ranged = false;                                          \
+        NAME ## _cursor_down(cp, bp->b_root, true);                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * point a NAME ## _cursor at first element not less than key:          \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to seek to                                  \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _cursor_seek(struct NAME ## _cursor *cp,                        \
+                     struct NAME *bp,                                   \
+                     TYPE key)                                          \
+{                                                                       \
+        struct NAME ## _node *np = bp->b_root;                          \
+        int d = -1;                                                     \
+                                                                        \
+        cp->bc_tree = bp;                                               \
+        cp->bc_ranged = false;                                          \
+        while (np != NULL) {                                            \
+                d++;                                                    \
+                cp->bc_node[d] = np;                                    \
+                cp->bc_idx[d] = KEY ## _lower(np->bn_elem, np->bn_len,  \
+                                              key);                     \
+                if (np->bn_leaf)                                        \
+                        np = NULL;                                      \
+                else                                                    \
+                        np = BTREE_KIDS(NAME, np)[cp->bc_idx[d]];       \
+        }                                                               \
+                                                                        \
+        cp->bc_depth = d;                                               \
+        NAME ## _cursor_up(cp);                                         \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * point a NAME ## _cursor at the elements in [lo, hi]:                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *      @bp:            pointer to NAME                                 \
+ *      @lo:            lowest element to visit                         \
+ *      @hi:            highest element to visit                        \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _range(struct NAME ## _cursor *cp,                              \
+               struct NAME *bp,                                         \
+               TYPE lo,                                                 \
+               TYPE hi)                                                 \
+{                                                                       \
+        NAME ## _cursor_seek(cp, bp, lo);                               \
+        cp->bc_lo = lo;                                                 \
+        cp->bc_hi = hi;                                                 \
+        cp->bc_ranged = true;                                           \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * get element under a NAME ## _cursor:                                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to element (valid until next change)    \
+ *      @failure:       NULL if cursor is at end or outside its range   \
+ */                                                                     \
+LINKAGE TYPE *                                                          \
+NAME ## _cursor_get(struct NAME ## _cursor *cp)                         \
+{                                                                       \
+        TYPE *ep = NULL;                                                \
+        int d = cp->bc_depth;                                           \
+                                                                        \
+        if (d < 0)                                                      \
+                return NULL;                                            \
+                                                                        \
+        ep = &cp->bc_node[d]->bn_elem[cp->bc_idx[d]];                   \
+        if (cp->bc_ranged && (NAME ## _cmp(*ep, cp->bc_lo) < 0 ||       \
+                              NAME ## _cmp(*ep, cp->bc_hi) > 0))        \
+                return NULL;                                            \
+        return ep;                                                      \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * is a NAME ## _cursor past the end of NAME (or of its range)?         \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if there is no element under cursor        \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _cursor_end(struct NAME ## _cursor *cp)                         \
+{                                                                       \
+        return NAME ## _cursor_get(cp) == NULL;                         \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * move a NAME ## _cursor to the next element:                          \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing (cursor ends up at end after last)      \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _cursor_next(struct NAME ## _cursor *cp)                        \
+{                                                                       \
+        struct NAME ## _node *np = NULL;                                \
+        int d = cp->bc_depth;                                           \
+        int i = -1;                                                     \
+                                                                        \
+        if (d < 0)                                                      \
+                return;                                                 \
+                                                                        \
+        np = cp->bc_node[d];                                            \
+        i = ++cp->bc_idx[d];                                            \
+        if (np->bn_leaf)                                                \
+                NAME ## _cursor_up(cp);                                 \
+        else                                                            \
+                NAME ## _cursor_down(cp, BTREE_KIDS(NAME, np)[i],       \
+                                     false);                            \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * move a NAME ## _cursor to the previous element:                      \
+ *                                                                      \
+ * args:                                                                \
+ *      @cp:            pointer to NAME ## _cursor                      \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing (cursor ends up at end before first)    \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _cursor_prev(struct NAME ## _cursor *cp)                        \
+{                                                                       \
+        struct NAME ## _node *np = NULL;                                \
+        int d = cp->bc_depth;                                           \
+        int i = -1;                                                     \
+                                                                        \
+        if (d < 0)                                                      \
+                return;                                                 \
+                                                                        \
+        np = cp->bc_node[d];                                            \
+        i = cp->bc_idx[d];                                              \
+        if (!np->bn_leaf) {                                             \
+                NAME ## _cursor_down(cp, BTREE_KIDS(NAME, np)[i],       \
+                                     true);                             \
+                return;                                                 \
+        }                                                               \
+        if (i > 0) {                                                    \
+                cp->bc_idx[d]--;                                        \
+                return;                                                 \
+        }                                                               \
+                                                                        \
+        do {                                                            \
+                d--;                                                    \
+        } while (d >= 0 && cp->bc_idx[d] == 0);                         \
+        if (d >= 0)                                                     \
+                cp->bc_idx[d]--;                                        \
+        cp->bc_depth = d;                                               \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * iterate through NAME ## _node elements (for internal use only):      \
+ *                                                                      \
+ * args:                                                                \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @fn:            pointer to function to run on elements          \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _node_for_each(struct NAME ## _node *np, void (*fn)(TYPE))      \
+{                                                                       \
+        int i = -1;                                                     \
+                                                                        \
+        if (np == NULL)                                                 \
+                return;                                                 \
+                                                                        \
+        for (i = 0; i < np->bn_len; i++) {                              \
+                if (!np->bn_leaf) {                                     \
+                        NAME ## _node_for_each(BTREE_KIDS(NAME, np)[i], \
+                                               fn);                     \
+                }                                                       \
+                fn(np->bn_elem[i]);                                     \
+        }                                                               \
+                                                                        \
+        if (!np->bn_leaf)                                               \
+                NAME ## _node_for_each(BTREE_KIDS(NAME, np)[i], fn);    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * iterate through NAME elements:                                       \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @fn:            pointer to function to run on elements          \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _for_each(struct NAME *bp, void (*fn)(TYPE))                    \
+{                                                                       \
+        NAME ## _node_for_each(bp->b_root, fn);                         \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * free memory allocated by NAME ## _node (for internal use only):      \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @np:            pointer to NAME ## _node                        \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _node_free(struct NAME *bp, struct NAME ## _node *np)           \
+{                                                                       \
+        int i = -1;                                                     \
+                                                                        \
+        if (np == NULL)                                                 \
+                return;                                                 \
+                                                                        \
+        for (i = 0; i < np->bn_len; i++) {                              \
+                if (!np->bn_leaf)                                       \
+                        NAME ## _node_free(bp,                          \
+                                           BTREE_KIDS(NAME, np)[i]);    \
+        }                                                               \
+                                                                        \
+        if (!np->bn_leaf)                                               \
+                NAME ## _node_free(bp, BTREE_KIDS(NAME, np)[i]);        \
+                                                                        \
+        NAME ## _node_release(bp, np);                                  \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * free memory allocated by NAME:                                       \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _free(struct NAME *bp)                                          \
+{                                                                       \
+        /* pooled nodes go away with their chunks, no walk needed */    \
+        if (bp->b_pool.pl_size != 0) {                                  \
+                btree_pool_free(&bp->b_pool);                           \
+                btree_pool_free(&bp->b_ipool);                          \
+        } else {                                                        \
+                NAME ## _node_free(bp, bp->b_root);                     \
+        }                                                               \
+        bp->b_root = NULL;                                              \
+        bp->b_size = 0;                                                 \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * add a NAME ## _node and everything under it to NAME ## _stats        \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @depth:         depth of node (0 for root)                      \
+ *      @sp:            pointer to NAME ## _stats                       \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _node_stats(struct NAME ## _node *np,                           \
+                    int depth,                                          \
+                    struct NAME ## _stats *sp)                          \
+{                                                                       \
+        int i = -1;                                                     \
+                                                                        \
+        sp->st_level[depth]++;                                          \
+        sp->st_count += (size_t)np->bn_len;                             \
+        if (depth + 1 > sp->st_height)                                  \
+                sp->st_height = depth + 1;                              \
+        if (depth != 0 && np->bn_len < sp->st_min_len)                  \
+                sp->st_min_len = np->bn_len;                            \
+                                                                        \
+        if (np->bn_leaf) {                                              \
+                sp->st_leaves++;                                        \
+                return;                                                 \
+        }                                                               \
+                                                                        \
+        sp->st_inodes++;                                                \
+        for (i = 0; i <= np->bn_len; i++)                               \
+                NAME ## _node_stats(BTREE_KIDS(NAME, np)[i], depth + 1, \
+                                    sp);                                \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * get shape, fill and memory use of NAME:                              \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @sp:            pointer to NAME ## _stats to fill in            \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _stats(struct NAME *bp, struct NAME ## _stats *sp)              \
+{                                                                       \
+        size_t nodes = 0;                                               \
+                                                                        \
+        memset(sp, 0, sizeof(*sp));                                     \
+        sp->st_min_len = (DEGREE << 1) - 1;                             \
+        if (bp->b_root != NULL)                                         \
+                NAME ## _node_stats(bp->b_root, 0, sp);                 \
+                                                                        \
+        nodes = sp->st_leaves + sp->st_inodes;                          \
+        if (nodes != 0) {                                               \
+                sp->st_fill = (double)sp->st_count / (double)nodes /    \
+                              (double)((DEGREE << 1) - 1);              \
+        }                                                               \
+        if (nodes < 2)                                                  \
+                sp->st_min_len = (int)sp->st_count;                     \
+        sp->st_min_fill = (double)sp->st_min_len /                      \
+                          (double)((DEGREE << 1) - 1);                  \
+                                                                        \
+        sp->st_bytes = sizeof(*bp);                                     \
+        if (bp->b_pool.pl_size != 0) {                                  \
+                sp->st_bytes += btree_pool_bytes(&bp->b_pool) +         \
+                                btree_pool_bytes(&bp->b_ipool);         \
+        } else {                                                        \
+                sp->st_bytes += sp->st_leaves *                         \
+                                sizeof(struct NAME ## _node) +          \
+                                sp->st_inodes *                         \
+                                BTREE_INODE_SIZE(NAME, RANKED);         \
+        }                                                               \
+                                                                        \
+        BTREE_COUNTERS_GET(NAME, &sp->st_counters);                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * zero event counters of NAME (no-op without BTREE_COUNTERS):          \
+ *                                                                      \
+ * args:                                                                \
+ *      none                                                            \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _counters_reset(void)                                           \
+{                                                                       \
+        BTREE_COUNTERS_RESET(NAME);                                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * compare two NAME elements for qsort (for internal use only):         \
+ *                                                                      \
+ * args:                                                                \
+ *      @a:             pointer to first element                        \
+ *      @b:             pointer to second element                       \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       CMP_FN of elements                              \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _elem_cmp(const void *a, const void *b)                         \
+{                                                                       \
+        return NAME ## _cmp(*(TYPE const *)a, *(TYPE const *)b);        \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * number of nodes in a bulk loaded level (for internal use only):      \
+ *                                                                      \
+ * args:                                                                \
+ *      @n:             number of elements in level                     \
+ *      @cap:           target number of elements per node              \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       number of nodes                                 \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE size_t                                                          \
+NAME ## _bulk_nodes(size_t n, size_t cap)                               \
+{                                                                       \
+        size_t nodes = 0;                                               \
+                                                                        \
+        /* one separator goes up between every pair of nodes */         \
+        nodes = (n + cap + 1) / (cap + 1);                              \
+        /* but never leave a node under DEGREE - 1 elements */          \
+        if (nodes > (n + 1) / DEGREE)                                   \
+                nodes = (n + 1) / DEGREE;                               \
+        if (nodes == 0)                                                 \
+                nodes = 1;                                              \
+        return nodes;                                                   \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * build one level of a bulk loaded NAME (for internal use only):       \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @src:           sorted elements of level                        \
+ *      @sep:           where to write separators for next level        \
+ *      @kids:          kids of level, replaced by the new nodes        \
+ *      @n:             number of elements in level                     \
+ *      @cap:           target number of elements per node              \
+ *      @leaf:          is this the leaf level?                         \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       number of nodes built                           \
+ *      @failure:       0 and errno set, kids freed                     \
+ */                                                                     \
+LINKAGE size_t                                                          \
+NAME ## _bulk_level(struct NAME *bp,                                    \
+                    TYPE *src,                                          \
+                    TYPE *sep,                                          \
+                    struct NAME ## _node **kids,                        \
+                    size_t n,                                           \
+                    size_t cap,                                         \
+                    bool leaf)                                          \
+{                                                                       \
+        struct NAME ## _node *np = NULL;                                \
+        size_t nodes = NAME ## _bulk_nodes(n, cap);                     \
+        size_t base = (n - (nodes - 1)) / nodes;                        \
+        size_t extra = (n - (nodes - 1)) % nodes;                       \
+        size_t j = 0;                                                   \
+        size_t p = 0;                                                   \
+        size_t k = 0;                                                   \
+        int m = -1;                                                     \
+        int i = -1;                                                     \
+                                                                        \
+        /* sep and kids may alias src and the old kids: we only */      \
+        /* ever write behind what has already been read */              \
+        for (j = 0; j < nodes; j++) {                                   \
+                np = NAME ## _node_new(bp, leaf);                       \
+                if (np == NULL)                                         \
+                        goto fail;                                      \
+                m = (int)(base + (j < extra));                          \
+                for (i = 0; i < m; i++)                                 \
+                        np->bn_elem[i] = src[p++];                      \
+                if (!leaf) {                                            \
+                        for (i = 0; i <= m; i++)                        \
+                                BTREE_KIDS(NAME, np)[i] = kids[k++];    \
+                }                                                       \
+                np->bn_len = m;                                         \
+                if (RANKED && !leaf)                                    \
+                        NAME ## _node_resize(np);                       \
+                kids[j] = np;                                           \
+                if (j < nodes - 1)                                      \
+                        sep[j] = src[p++];                              \
+        }                                                               \
+                                                                        \
+        return nodes;                                                   \
+fail:                                                                   \
+        while (j > 0)                                                   \
+                NAME ## _node_free(bp, kids[--j]);                      \
+        while (!leaf && k <= n)                                         \
+                NAME ## _node_free(bp, kids[k++]);                      \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * build NAME from sorted elements without splitting:                   \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to empty NAME                           \
+ *      @arr:           sorted elements                                 \
+ *      @n:             number of elements                              \
+ *      @pct:           how full to pack nodes (1 to 100 percent)       \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _bulk_load(struct NAME *bp, TYPE *arr, size_t n, int pct)       \
+{                                                                       \
+        struct NAME ## _node **kids = NULL;                             \
+        TYPE *sep = NULL;                                               \
+        size_t count = n;                                               \
+        size_t cap = 0;                                                 \
+        size_t nodes = 0;                                               \
+                                                                        \
+        if (bp->b_root != NULL || pct < 1 || pct > 100) {               \
+                errno = EINVAL;                                         \
+                return -1;                                              \
+        }                                                               \
+        if (n == 0)                                                     \
+                return 0;                                               \
+                                                                        \
+        cap = ((size_t)((DEGREE << 1) - 1) * (size_t)pct) / 100;        \
+        if (cap == 0)                                                   \
+                cap = 1;                                                \
+                                                                        \
+        nodes = NAME ## _bulk_nodes(n, cap);                            \
+        kids = malloc(nodes * sizeof(*kids));                           \
+        sep = malloc(nodes * sizeof(*sep));                             \
+        if (kids == NULL || sep == NULL)                                \
+                goto fail;                                              \
+                                                                        \
+        nodes = NAME ## _bulk_level(bp, arr, sep, kids, n, cap,         \
+                                    true);                              \
+        while (nodes > 1) {                                             \
+                n = nodes - 1;                                          \
+                nodes = NAME ## _bulk_level(bp, sep, sep, kids, n,      \
+                                            cap, false);                \
+        }                                                               \
+        if (nodes == 0)                                                 \
+                goto fail;                                              \
+                                                                        \
+        bp->b_root = kids[0];                                           \
+        bp->b_size = count;                                             \
+        free(sep);                                                      \
+        free(kids);                                                     \
+        return 0;                                                       \
+fail:                                                                   \
+        free(sep);                                                      \
+        free(kids);                                                     \
+        return -1;                                                      \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * sort elements and build NAME from them without splitting:            \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to empty NAME                           \
+ *      @arr:           elements (sorted in place)                      \
+ *      @n:             number of elements                              \
+ *      @pct:           how full to pack nodes (1 to 100 percent)       \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _sort_load(struct NAME *bp, TYPE *arr, size_t n, int pct)       \
+{                                                                       \
+        if (bp->b_root != NULL || pct < 1 || pct > 100) {               \
+                errno = EINVAL;                                         \
+                return -1;                                              \
+        }                                                               \
+                                                                        \
+        qsort(arr, n, sizeof(*arr), NAME ## _elem_cmp);                 \
+        return NAME ## _bulk_load(bp, arr, n, pct);                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * add a run of sorted elements under a NAME ## _node that is not full  \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @arr:           sorted elements                                 \
+ *      @n:             number of elements                              \
+ *      @hi:            elements must be less than this to belong under \
+ *                      np (NULL if np has no upper bound)              \
+ *      @donep:         where to store number of elements added         \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0 (*donep may be less than n if the run leaves  \
+ *                      np or np fills up)                              \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _node_add_run(struct NAME *bp,                                  \
+                      struct NAME ## _node *np,                         \
+                      TYPE *arr,                                        \
+                      size_t n,                                         \
+                      TYPE *hi,                                         \
+                      size_t *donep)                                    \
+{                                                                       \
+        struct NAME ## _node *kid = NULL;                               \
+        size_t done = 0;                                                \
+        size_t room = 0;                                                \
+        size_t k = 0;                                                   \
+        int ret = 0;                                                    \
+        int i = -1;                                                     \
+        int j = -1;                                                     \
+        int m = -1;                                                     \
+                                                                        \
+        if (np->bn_leaf) {                                              \
+                room = (size_t)(((DEGREE << 1) - 1) - np->bn_len);      \
+                if (room > n)                                           \
+                        room = n;                                       \
+                m = (int)room;                                          \
+                if (hi != NULL)                                         \
+                        m = KEY ## _lower(arr, m, *hi);                 \
+                                                                        \
+                /* merge from the back: one shift-and-copy per leaf */  \
+                i = np->bn_len - 1;                                     \
+                j = m - 1;                                              \
+                k = (size_t)(np->bn_len + m);                           \
+                while (j >= 0) {                                        \
+                        if (i >= 0 &&                                   \
+                            NAME ## _cmp(np->bn_elem[i], arr[j]) > 0)   \
+                                np->bn_elem[--k] = np->bn_elem[i--];    \
+                        else                                            \
+                                np->bn_elem[--k] = arr[j--];            \
+                }                                                       \
+                np->bn_len += m;                                        \
+                *donep = (size_t)m;                                     \
+                return 0;                                               \
+        }                                                               \
+                                                                        \
+        while (done < n &&                                              \
+               (hi == NULL || NAME ## _cmp(arr[done], *hi) < 0)) {      \
+                i = KEY ## _upper(np->bn_elem, np->bn_len, arr[done]);  \
+                kid = BTREE_KIDS(NAME, np)[i];                          \
+                if (kid->bn_len == ((DEGREE << 1) - 1)) {               \
+                        /* caller splits np and comes back down */      \
+                        if (np->bn_len == ((DEGREE << 1) - 1))          \
+                                break;                                  \
+                        if (NAME ## _node_split(bp, np, kid, i) < 0) {  \
+                                ret = -1;                               \
+                                break;                                  \
+                        }                                               \
+                        i = KEY ## _upper(np->bn_elem, np->bn_len,      \
+                                          arr[done]);                   \
+                        kid = BTREE_KIDS(NAME, np)[i];                  \
+                }                                                       \
+                                                                        \
+                ret = NAME ## _node_add_run(bp, kid, arr + done,        \
+                                            n - done,                   \
+                                            i < np->bn_len ?            \
+                                            &np->bn_elem[i] : hi,       \
+                                            &k);                        \
+                if (RANKED)                                             \
+                        BTREE_SIZES(NAME, np)[i] += k;                  \
+                done += k;                                              \
+                if (ret < 0)                                            \
+                        break;                                          \
+        }                                                               \
+                                                                        \
+        *donep = done;                                                  \
+        return ret;                                                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * add sorted elements to NAME, descending once per run of elements     \
+ * that land in the same leaf:                                          \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @arr:           sorted elements                                 \
+ *      @n:             number of elements                              \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set (a prefix of arr may have      \
+ *                      been added)                                     \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _add_sorted(struct NAME *bp, TYPE *arr, size_t n)               \
+{                                                                       \
+        size_t done = 0;                                                \
+        size_t k = 0;                                                   \
+        int ret = 0;                                                    \
+                                                                        \
+        if (n == 0)                                                     \
+                return 0;                                               \
+        if (bp->b_root == NULL)                                         \
+                return NAME ## _bulk_load(bp, arr, n, 100);             \
+                                                                        \
+        while (done < n) {                                              \
+                if (bp->b_root->bn_len == ((DEGREE << 1) - 1) &&        \
+                    NAME ## _root_split(bp) < 0)                        \
+                        return -1;                                      \
+                ret = NAME ## _node_add_run(bp, bp->b_root, arr + done, \
+                                            n - done, NULL, &k);        \
+                bp->b_size += k;                                        \
+                done += k;                                              \
+                if (ret < 0)                                            \
+                        return -1;                                      \
+        }                                                               \
+                                                                        \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * sort elements and add them to NAME in one batch:                     \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @arr:           elements (sorted in place)                      \
+ *      @n:             number of elements                              \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set (some elements may have been   \
+ *                      added)                                          \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _add_batch(struct NAME *bp, TYPE *arr, size_t n)                \
+{                                                                       \
+        qsort(arr, n, sizeof(*arr), NAME ## _elem_cmp);                 \
+        return NAME ## _add_sorted(bp, arr, n);                         \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * save a NAME ## _node and its subtree (for internal use only):        \
+ *                                                                      \
+ * args:                                                                \
+ *      @wp:            pointer to btree_writer                         \
+ *      @hp:            pointer to btree_heap                           \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @offp:          where to store offset of saved node             \
+ *      @countp:        count of elements saved so far                  \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _node_save(struct btree_writer *wp,                             \
+                   struct btree_heap *hp,                               \
+                   struct NAME ## _node *np,                            \
+                   uint64_t *offp,                                      \
+                   uint64_t *countp)                                    \
+{                                                                       \
+        struct NAME ## _dinode dn;                                      \
+        size_t size = sizeof(struct NAME ## _dinode);                   \
+        int i = -1;                                                     \
+                                                                        \
+        /* no stack garbage in padding, so saves are reproducible */    \
+        memset(&dn, 0, sizeof(dn));                                     \
+                                                                        \
+        /* kids go first so their offsets are known (post-order) */     \
+        if (np->bn_leaf) {                                              \
+                size = sizeof(struct NAME ## _node);                    \
+        } else {                                                        \
+                for (i = 0; i <= np->bn_len; i++) {                     \
+                        if (NAME ## _node_save(wp, hp,                  \
+                                               BTREE_KIDS(NAME, np)[i], \
+                                               &dn.di_kids[i],          \
+                                               countp) < 0)             \
+                                return -1;                              \
+                }                                                       \
+        }                                                               \
+                                                                        \
+        dn.di_node.bn_len = np->bn_len;                                 \
+        dn.di_node.bn_leaf = np->bn_leaf;                               \
+        for (i = 0; i < np->bn_len; i++) {                              \
+                if (KEY ## _store(&dn.di_node.bn_elem[i],               \
+                                  np->bn_elem[i], hp) < 0)              \
+                        return -1;                                      \
+        }                                                               \
+        *countp += (uint64_t)np->bn_len;                                \
+                                                                        \
+        size = (size + 7) & ~(size_t)7;                                 \
+        if (btree_writer_align(wp, size) < 0)                           \
+                return -1;                                              \
+        *offp = wp->bw_off;                                             \
+        return btree_writer_put(wp, &dn, size);                         \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * save NAME to a file that NAME ## _open_mmap can map:                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @fd:            file open for writing, at its start             \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _save(struct NAME *bp, int fd)                                  \
+{                                                                       \
+        struct btree_file file = {0};                                   \
+        struct btree_writer *wp = NULL;                                 \
+        struct btree_heap heap = {0};                                   \
+        int ret = -1;                                                   \
+                                                                        \
+        wp = malloc(sizeof(*wp));                                       \
+        if (wp == NULL)                                                 \
+                return -1;                                              \
+        btree_heap_init(&heap);                                         \
+                                                                        \
+        if (btree_writer_init(wp, fd) < 0)                              \
+                goto out;                                               \
+        if (bp->b_root != NULL &&                                       \
+            NAME ## _node_save(wp, &heap, bp->b_root, &file.bf_root,    \
+                               &file.bf_count) < 0)                     \
+                goto out;                                               \
+                                                                        \
+        file.bf_degree = DEGREE;                                        \
+        file.bf_elem = sizeof(TYPE);                                    \
+        ret = btree_writer_finish(wp, &heap, &file);                    \
+out:                                                                    \
+        btree_heap_free(&heap);                                         \
+        free(wp);                                                       \
+        return ret;                                                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * map a file written by NAME ## _save:                                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @path:          path of file                                    \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _open_mmap(struct btree_map *mp, const char *path)              \
+{                                                                       \
+        return btree_map_open(mp, path, DEGREE, sizeof(TYPE));          \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * get a node of a mapped NAME (for internal use only):                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @off:           offset of node                                  \
+ *      @below:         offset node must lie below (kids are saved      \
+ *                      before their parents, so this rules out cycles) \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to node                                 \
+ *      @failure:       NULL if offset or node is out of bounds         \
+ */                                                                     \
+LINKAGE const struct NAME ## _node *                                    \
+NAME ## _map_node(const struct btree_map *mp, uint64_t off,             \
+                  uint64_t below)                                       \
+{                                                                       \
+        const struct NAME ## _node *np = NULL;                          \
+        unsigned char leaf = 0;                                         \
+                                                                        \
+        if (off >= below)                                               \
+                return NULL;                                            \
+        np = btree_map_at(mp, off, sizeof(struct NAME ## _node));       \
+        if (np == NULL)                                                 \
+                return NULL;                                            \
+        /* a bad file may hold any byte where a bool belongs */         \
+        memcpy(&leaf, &np->bn_leaf, sizeof(leaf));                      \
+        if (leaf > 1 || np->bn_len < 0 ||                               \
+            np->bn_len > ((DEGREE << 1) - 1))                           \
+                return NULL;                                            \
+        if (!leaf &&                                                    \
+            !btree_map_at(mp, off, sizeof(struct NAME ## _dinode)))     \
+                return NULL;                                            \
+        return np;                                                      \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find a bound of key in a mapped node (for internal use only):        \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @np:            pointer to mapped NAME ## _node                 \
+ *      @key:           key to search for                               \
+ *      @eq:            upper bound instead of lower bound?             \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       index of first element >= key (> key if eq)     \
+ *      @failure:       -1 if an element can not be decoded             \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _map_search(const struct btree_map *mp,                         \
+                    const struct NAME ## _node *np,                     \
+                    TYPE key,                                           \
+                    bool eq)                                            \
+{                                                                       \
+        int base = 0;                                                   \
+        int half = 0;                                                   \
+        int n = np->bn_len;                                             \
+        int c = 0;                                                      \
+        TYPE e;                                                         \
+                                                                        \
+        /* elements are decoded one probe at a time, never up front */  \
+        while (n > 0) {                                                 \
+                half = n >> 1;                                          \
+                if (!KEY ## _load(np->bn_elem[base + half],             \
+                                  mp->bm_heap, mp->bm_heap_len, &e))    \
+                        return -1;                                      \
+                c = NAME ## _cmp(e, key);                               \
+                if (c < 0 || (eq && c == 0)) {                          \
+                        base += half + 1;                               \
+                        n -= half + 1;                                  \
+                } else {                                                \
+                        n = half;                                       \
+                }                                                       \
+        }                                                               \
+                                                                        \
+        return base;                                                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find a bound of key in a mapped NAME (for internal use only):        \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @key:           key to search for                               \
+ *      @eq:            upper bound instead of lower bound?             \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if first element >= key (> key if eq)      \
+ *                      was copied to out                               \
+ *      @failure:       false if there is no such element               \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _map_bound(const struct btree_map *mp,                          \
+                   TYPE key,                                            \
+                   bool eq,                                             \
+                   TYPE *out)                                           \
+{                                                                       \
+        const struct NAME ## _node *np = NULL;                          \
+        uint64_t below = mp->bm_file->bf_nodes;                         \
+        uint64_t off = mp->bm_file->bf_root;                            \
+        bool found = false;                                             \
+        int i = -1;                                                     \
+                                                                        \
+        while (off != 0 &&                                              \
+               (np = NAME ## _map_node(mp, off, below)) != NULL) {      \
+                /* a node with a bad element counts as a bad node */    \
+                i = NAME ## _map_search(mp, np, key, eq);               \
+                if (i < 0)                                              \
+                        break;                                          \
+                if (i < np->bn_len) {                                   \
+                        if (!KEY ## _load(np->bn_elem[i], mp->bm_heap,  \
+                                          mp->bm_heap_len, out))        \
+                                break;                                  \
+                        found = true;                                   \
+                }                                                       \
+                if (np->bn_leaf)                                        \
+                        break;                                          \
+                below = off;                                            \
+                off = ((const struct NAME ## _dinode *)np)->di_kids[i]; \
+        }                                                               \
+                                                                        \
+        return found;                                                   \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy first element of a mapped NAME not less than key:               \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @key:           key to search for                               \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if an element was copied to out            \
+ *      @failure:       false if every element is less than key         \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _map_lower_bound(const struct btree_map *mp,                    \
+                         TYPE key,                                      \
+                         TYPE *out)                                     \
+{                                                                       \
+        return NAME ## _map_bound(mp, key, false, out);                 \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy first element of a mapped NAME greater than key:                \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @key:           key to search for                               \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if an element was copied to out            \
+ *      @failure:       false if no element is greater than key         \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _map_upper_bound(const struct btree_map *mp,                    \
+                         TYPE key,                                      \
+                         TYPE *out)                                     \
+{                                                                       \
+        return NAME ## _map_bound(mp, key, true, out);                  \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy element of a mapped NAME equal to key:                          \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @key:           key to search for                               \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if an element was copied to out            \
+ *      @failure:       false if key is not in NAME                     \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _map_find(const struct btree_map *mp, TYPE key, TYPE *out)      \
+{                                                                       \
+        TYPE elem;                                                      \
+                                                                        \
+        if (!NAME ## _map_bound(mp, key, false, &elem))                 \
+                return false;                                           \
+        if (NAME ## _cmp(elem, key) != 0)                               \
+                return false;                                           \
+        *out = elem;                                                    \
+        return true;                                                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * iterate through mapped NAME ## _node elements                        \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @off:           offset of node                                  \
+ *      @below:         offset node must lie below                      \
+ *      @depth:         depth of node (0 for root)                      \
+ *      @fn:            pointer to function to run on elements          \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _map_node_for_each(const struct btree_map *mp,                  \
+                           uint64_t off,                                \
+                           uint64_t below,                              \
+                           int depth,                                   \
+                           void (*fn)(TYPE))                            \
+{                                                                       \
+        const struct NAME ## _dinode *dp = NULL;                        \
+        const struct NAME ## _node *np = NULL;                          \
+        int i = -1;                                                     \
+        TYPE e;                                                         \
+                                                                        \
+        /* a bad file must not be able to run the stack out */          \
+        if (depth >= BTREE_MAX_HEIGHT)                                  \
+                return;                                                 \
+        np = NAME ## _map_node(mp, off, below);                         \
+        if (np == NULL)                                                 \
+                return;                                                 \
+        dp = (const struct NAME ## _dinode *)np;                        \
+                                                                        \
+        for (i = 0; i < np->bn_len; i++) {                              \
+                if (!np->bn_leaf)                                       \
+                        NAME ## _map_node_for_each(mp, dp->di_kids[i],  \
+                                                   off, depth + 1, fn); \
+                /* elements pointing outside the heap are skipped */    \
+                if (KEY ## _load(np->bn_elem[i], mp->bm_heap,           \
+                                 mp->bm_heap_len, &e))                  \
+                        fn(e);                                          \
+        }                                                               \
+                                                                        \
+        if (!np->bn_leaf)                                               \
+                NAME ## _map_node_for_each(mp, dp->di_kids[i], off,     \
+                                           depth + 1, fn);              \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * iterate through mapped NAME elements:                                \
+ *                                                                      \
+ * args:                                                                \
+ *      @mp:            pointer to btree_map                            \
+ *      @fn:            pointer to function to run on elements          \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _map_for_each(const struct btree_map *mp, void (*fn)(TYPE))     \
+{                                                                       \
+        if (mp->bm_file->bf_root != 0)                                  \
+                NAME ## _map_node_for_each(mp, mp->bm_file->bf_root,    \
+                                           mp->bm_file->bf_nodes, 0,    \
+                                           fn);                         \
+}
+
+
+/**
+ * define rank and select queries of a btree whose internal nodes keep
+ * subtree sizes (for internal use only, see BTREE_RANKED_DEFINE):
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @NAME:          name of btree struct
+ *      @KEY:           prefix of search kernels
+ *
+ * ret:
+ *      @success:       generated functions
+ *      @failure:       does not fail
+ */
+#define BTREE_RANK_DEFINE(LINKAGE, TYPE, NAME, KEY)                     \
+                                                                        \
+/**                                                                     \
+ * count elements of NAME below a bound of key (for internal use only): \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *      @eq:            count elements equal to key too?                \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       number of elements < key (<= key if eq)         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE size_t                                                          \
+NAME ## _rank_bound(struct NAME *bp, TYPE key, bool eq)                 \
+{                                                                       \
+        struct NAME ## _node *np = bp->b_root;                          \
+        size_t rank = 0;                                                \
+        int i = -1;                                                     \
+        int j = -1;                                                     \
+                                                                        \
+        while (np != NULL) {                                            \
+                if (eq)                                                 \
+                        i = KEY ## _upper(np->bn_elem, np->bn_len,      \
+                                          key);                         \
+                else                                                    \
+                        i = KEY ## _lower(np->bn_elem, np->bn_len,      \
+                                          key);                         \
+                rank += (size_t)i;                                      \
+                if (np->bn_leaf)                                        \
+                        break;                                          \
+                for (j = 0; j < i; j++)                                 \
+                        rank += BTREE_SIZES(NAME, np)[j];               \
+                np = BTREE_KIDS(NAME, np)[i];                           \
+        }                                                               \
+                                                                        \
+        return rank;                                                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * count elements of NAME less than key:                                \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to rank                                     \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       number of elements < key                        \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE size_t                                                          \
+NAME ## _rank(struct NAME *bp, TYPE key)                                \
+{                                                                       \
+        return NAME ## _rank_bound(bp, key, false);                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * get element of NAME by its position in sorted order:                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @idx:           position (0 for smallest element)               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to element                              \
+ *      @failure:       NULL if idx >= NAME ## _size                    \
+ */                                                                     \
+LINKAGE TYPE *                                                          \
+NAME ## _select(struct NAME *bp, size_t idx)                            \
+{                                                                       \
+        struct NAME ## _node *np = bp->b_root;                          \
+        size_t size = 0;                                                \
+        int i = -1;                                                     \
+                                                                        \
+        if (idx >= bp->b_size)                                          \
+                return NULL;                                            \
+                                                                        \
+        while (!np->bn_leaf) {                                          \
+                for (i = 0; i < np->bn_len; i++) {                      \
+                        size = BTREE_SIZES(NAME, np)[i];                \
+                        if (idx < size)                                 \
+                                break;                                  \
+                        if (idx == size)                                \
+                                return &np->bn_elem[i];                 \
+                        idx -= size + 1;                                \
+                }                                                       \
+                np = BTREE_KIDS(NAME, np)[i];                           \
+        }                                                               \
+                                                                        \
+        return &np->bn_elem[idx];                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * count elements of NAME in [lo, hi]:                                  \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @lo:            lowest element to count                         \
+ *      @hi:            highest element to count                        \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       number of elements >= lo and <= hi              \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE size_t                                                          \
+NAME ## _count_range(struct NAME *bp, TYPE lo, TYPE hi)                 \
+{                                                                       \
+        if (NAME ## _cmp(lo, hi) > 0)                                   \
+                return 0;                                               \
+        return NAME ## _rank_bound(bp, hi, true) -                      \
+               NAME ## _rank_bound(bp, lo, false);                      \
+}
+
+#endif /* BTREE_H */
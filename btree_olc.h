@@ -0,0 +1,800 @@
+#ifndef BTREE_OLC_H
+#define BTREE_OLC_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "btree.h"
+
+/* version latch bit set while a node is being written */
+#define BTREE_OLC_LOCKED        1u
+
+/**
+ * tell the cpu we are spinning (for internal use only):
+ *
+ * args:
+ *      none
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static inline void
+btree_olc_relax(void)
+{
+#if defined(__SSE2__)
+        _mm_pause();
+#endif
+}
+
+/**
+ * wait for a version latch to be free and read it:
+ *
+ * args:
+ *      @vp:            pointer to version latch
+ *
+ * ret:
+ *      @success:       unlocked version
+ *      @failure:       does not fail
+ */
+static inline uint64_t
+btree_olc_read(_Atomic uint64_t *vp)
+{
+        uint64_t v = 0;
+
+        while ((v = atomic_load_explicit(vp, memory_order_acquire)) &
+               BTREE_OLC_LOCKED)
+                btree_olc_relax();
+        return v;
+}
+
+/**
+ * check that nothing was written under a version latch since it was read:
+ *
+ * args:
+ *      @vp:            pointer to version latch
+ *      @v:             version returned by btree_olc_read()
+ *
+ * ret:
+ *      @success:       true if everything read since then is consistent
+ *      @failure:       false if caller has to restart
+ */
+static inline bool
+btree_olc_check(_Atomic uint64_t *vp, uint64_t v)
+{
+        /* order the optimistic reads before the second version read */
+        atomic_thread_fence(memory_order_acquire);
+        return atomic_load_explicit(vp, memory_order_relaxed) == v;
+}
+
+/**
+ * turn an optimistic read of a version latch into a write lock:
+ *
+ * args:
+ *      @vp:            pointer to version latch
+ *      @v:             version returned by btree_olc_read()
+ *
+ * ret:
+ *      @success:       true if latch is now locked by caller
+ *      @failure:       false if caller has to restart
+ */
+static inline bool
+btree_olc_lock(_Atomic uint64_t *vp, uint64_t v)
+{
+        return atomic_compare_exchange_strong_explicit(vp, &v,
+                                                       v | BTREE_OLC_LOCKED,
+                                                       memory_order_acquire,
+                                                       memory_order_relaxed);
+}
+
+/**
+ * release a write locked version latch:
+ *
+ * args:
+ *      @vp:            pointer to version latch
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
+static inline void
+btree_olc_unlock(_Atomic uint64_t *vp)
+{
+        /* clears the lock bit and bumps the version in one go */
+        atomic_fetch_add_explicit(vp, BTREE_OLC_LOCKED, memory_order_release);
+}
+
+/**
+ * define a new btree that many threads can use at once:
+ *
+ * readers never write shared memory: they read a node's version, copy
+ * what they need and check the version again, restarting from the root
+ * if a writer got in between. writers latch only the node they insert
+ * into, or a full node and its parent while splitting it. nodes are
+ * never freed before NAME ## _free, so no reader can see freed memory.
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @CMP_FN:        element comparison function
+ *      @NAME:          name of generated struct
+ *
+ * ret:
+ *      @success:       generated btree struct and functions
+ *      @failure:       does not fail
+ */
+#define BTREE_OLC_DEFINE(LINKAGE, TYPE, DEGREE, CMP_FN, NAME)           \
+        BTREE_KEY_DEFINE(LINKAGE, TYPE, CMP_FN, NAME ## _key)           \
+        BTREE_OLC_DEFINE_KEY(LINKAGE, TYPE, DEGREE, CMP_FN, NAME,       \
+                             NAME ## _key)
+
+/**
+ * define a new concurrent btree with its own in-node search kernels:
+ *
+ * args:
+ *      @LINKAGE:       linkage of generated functions
+ *      @TYPE:          element type
+ *      @DEGREE:        degree of btree nodes
+ *      @CMP_FN:        element comparison function
+ *      @NAME:          name of generated struct
+ *      @KEY:           prefix of KEY ## _lower and KEY ## _upper
+ *
+ * ret:
+ *      @success:       generated btree struct and functions
+ *      @failure:       does not fail
+ */
+#define BTREE_OLC_DEFINE_KEY(LINKAGE, TYPE, DEGREE, CMP_FN, NAME, KEY)  \
+                                                                        \
+/* concurrent btree node (all of a leaf, head of an internal node) */   \
+struct NAME ## _node {                                                  \
+        /* version latch (odd while locked) */                          \
+        _Atomic uint64_t        bn_version;                             \
+        /* number of keys in node */                                    \
+        int                     bn_len;                                 \
+        /* is this node a leaf? */                                      \
+        bool                    bn_leaf;                                \
+        /* elements */                                                  \
+        TYPE                    bn_elem[(DEGREE << 1) - 1];             \
+};                                                                      \
+                                                                        \
+/* internal concurrent btree node */                                    \
+struct NAME ## _inode {                                                 \
+        /* header and elements */                                       \
+        struct NAME ## _node    bi_node;                                \
+        /* array of pointers to children */                             \
+        struct NAME ## _node    *bi_kids[(DEGREE << 1)];                \
+};                                                                      \
+                                                                        \
+/* concurrent btree */                                                  \
+struct NAME {                                                           \
+        /* root node of btree */                                        \
+        struct NAME ## _node    *_Atomic b_root;                        \
+};                                                                      \
+                                                                        \
+/* lock-free scan over a concurrent btree */                            \
+struct NAME ## _scan {                                                  \
+        /* btree being scanned */                                       \
+        struct NAME             *sc_tree;                               \
+        /* rest of one leaf and the element that follows it */          \
+        TYPE                    sc_elem[DEGREE << 1];                   \
+        /* number of elements in sc_elem (0 at end) */                  \
+        int                     sc_len;                                 \
+        /* next element of sc_elem to hand out */                       \
+        int                     sc_idx;                                 \
+};                                                                      \
+                                                                        \
+/**                                                                     \
+ * initialize a NAME (before any thread uses it):                       \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _init(struct NAME *bp)                                          \
+{                                                                       \
+        atomic_init(&bp->b_root, NULL);                                 \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * create a new NAME ## _node (for internal use only):                  \
+ *                                                                      \
+ * args:                                                                \
+ *      @leaf:          is this node a leaf?                            \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to new NAME ## _node (cache aligned)    \
+ *      @failure:       NULL and errno set                              \
+ */                                                                     \
+LINKAGE struct NAME ## _node *                                          \
+NAME ## _node_new(bool leaf)                                            \
+{                                                                       \
+        struct NAME ## _node *np = NULL;                                \
+        size_t size = sizeof(struct NAME ## _inode);                    \
+                                                                        \
+        if (leaf)                                                       \
+                size = sizeof(struct NAME ## _node);                    \
+        /* keep version latches of different nodes apart */             \
+        size = (size + BTREE_POOL_ALIGN - 1) &                          \
+               ~(size_t)(BTREE_POOL_ALIGN - 1);                         \
+                                                                        \
+        np = aligned_alloc(BTREE_POOL_ALIGN, size);                     \
+        if (np == NULL)                                                 \
+                return NULL;                                            \
+                                                                        \
+        atomic_init(&np->bn_version, 0);                                \
+        np->bn_leaf = leaf;                                             \
+        np->bn_len = 0;                                                 \
+        return np;                                                      \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy elements of a NAME ## _node under an optimistic read            \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @v:             version returned by btree_olc_read()            \
+ *      @elem:          where to copy elements                          \
+ *      @lenp:          where to store number of elements               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if copy is consistent                      \
+ *      @failure:       false if caller has to restart                  \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _node_snap(struct NAME ## _node *np,                            \
+                   uint64_t v,                                          \
+                   TYPE *elem,                                          \
+                   int *lenp)                                           \
+{                                                                       \
+        int len = np->bn_len;                                           \
+                                                                        \
+        /* a torn length only matters until the version check fails */  \
+        if (len < 0 || len > ((DEGREE << 1) - 1))                       \
+                len = 0;                                                \
+        memcpy(elem, np->bn_elem, (size_t)len * sizeof(*elem));         \
+        *lenp = len;                                                    \
+                                                                        \
+        /* CMP_FN only ever sees the checked copy */                    \
+        return btree_olc_check(&np->bn_version, v);                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * read a kid of a NAME ## _node and latch it for optimistic reading    \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @v:             version returned by btree_olc_read()            \
+ *      @idx:           index of kid                                    \
+ *      @vp:            where to store version of kid                   \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       pointer to kid                                  \
+ *      @failure:       NULL if caller has to restart                   \
+ */                                                                     \
+LINKAGE struct NAME ## _node *                                          \
+NAME ## _node_kid(struct NAME ## _node *np,                             \
+                  uint64_t v,                                           \
+                  int idx,                                              \
+                  uint64_t *vp)                                         \
+{                                                                       \
+        struct NAME ## _node *kid = BTREE_KIDS(NAME, np)[idx];          \
+                                                                        \
+        /* kid may be garbage until np is known not to have changed */  \
+        if (!btree_olc_check(&np->bn_version, v))                       \
+                return NULL;                                            \
+        *vp = btree_olc_read(&kid->bn_version);                         \
+        /* and np must not have split kid before we read its version */ \
+        if (!btree_olc_check(&np->bn_version, v))                       \
+                return NULL;                                            \
+        return kid;                                                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * split a NAME ## _node, both nodes write locked                       \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @np:            pointer to NAME ## _node                        \
+ *      @kid:           kid to split                                    \
+ *      @idx:           index to split on                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _node_split(struct NAME ## _node *np,                           \
+                    struct NAME ## _node *kid,                          \
+                    int idx)                                            \
+{                                                                       \
+        struct NAME ## _node *new = NULL;                               \
+        int i = -1;                                                     \
+                                                                        \
+        new = NAME ## _node_new(kid->bn_leaf);                          \
+        if (new == NULL)                                                \
+                return -1;                                              \
+                                                                        \
+        /* new is not reachable yet, so it needs no latch */            \
+        new->bn_len = DEGREE - 1;                                       \
+        for (i = 0; i < (DEGREE - 1); i++)                              \
+                new->bn_elem[i] = kid->bn_elem[DEGREE + i];             \
+        if (!kid->bn_leaf) {                                            \
+                for (i = 0; i < DEGREE; i++) {                          \
+                        BTREE_KIDS(NAME, new)[i] =                      \
+                                BTREE_KIDS(NAME, kid)[DEGREE + i];      \
+                }                                                       \
+        }                                                               \
+        kid->bn_len = DEGREE - 1;                                       \
+                                                                        \
+        for (i = np->bn_len; i >= idx + 1; i--)                         \
+                BTREE_KIDS(NAME, np)[i + 1] = BTREE_KIDS(NAME, np)[i];  \
+        BTREE_KIDS(NAME, np)[idx + 1] = new;                            \
+                                                                        \
+        for (i = np->bn_len - 1; i >= idx; i--)                         \
+                np->bn_elem[i + 1] = np->bn_elem[i];                    \
+        np->bn_elem[idx] = kid->bn_elem[DEGREE - 1];                    \
+                                                                        \
+        np->bn_len++;                                                   \
+        return 0;                                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * split a full NAME ## _node found while adding                        \
+ * (for internal use only):                                             \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @parent:        parent of np (NULL if np is root)               \
+ *      @pv:            version of parent                               \
+ *      @idx:           index of np in parent                           \
+ *      @np:            pointer to full NAME ## _node                   \
+ *      @v:             version of np                                   \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       1 if np was split, 0 if caller has to restart   \
+ *      @failure:       -1 and errno set                                \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _node_grow(struct NAME *bp,                                     \
+                   struct NAME ## _node *parent,                        \
+                   uint64_t pv,                                         \
+                   int idx,                                             \
+                   struct NAME ## _node *np,                            \
+                   uint64_t v)                                          \
+{                                                                       \
+        struct NAME ## _node *root = NULL;                              \
+        int ret = 1;                                                    \
+                                                                        \
+        if (parent != NULL && !btree_olc_lock(&parent->bn_version, pv)) \
+                return 0;                                               \
+        if (!btree_olc_lock(&np->bn_version, v)) {                      \
+                if (parent != NULL)                                     \
+                        btree_olc_unlock(&parent->bn_version);          \
+                return 0;                                               \
+        }                                                               \
+                                                                        \
+        if (parent != NULL) {                                           \
+                if (NAME ## _node_split(parent, np, idx) < 0)           \
+                        ret = -1;                                       \
+        } else if (atomic_load(&bp->b_root) != np) {                    \
+                /* someone else grew the tree first */                  \
+                ret = 0;                                                \
+        } else if ((root = NAME ## _node_new(false)) == NULL) {         \
+                ret = -1;                                               \
+        } else {                                                        \
+                BTREE_KIDS(NAME, root)[0] = np;                         \
+                if (NAME ## _node_split(root, np, 0) < 0) {             \
+                        free(root);                                     \
+                        ret = -1;                                       \
+                } else {                                                \
+                        /* old root stays locked until this is seen */  \
+                        atomic_store(&bp->b_root, root);                \
+                }                                                       \
+        }                                                               \
+                                                                        \
+        btree_olc_unlock(&np->bn_version);                              \
+        if (parent != NULL)                                             \
+                btree_olc_unlock(&parent->bn_version);                  \
+        return ret;                                                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * add element to NAME (safe to call from many threads); unlike the     \
+ * single threaded btree, NAME holds each key at most once, so scans    \
+ * can resume after the last key they saw:                              \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @elem:          element to add                                  \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       0                                               \
+ *      @failure:       -1 and errno set (EEXIST if elem is in NAME)    \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _add(struct NAME *bp, TYPE elem)                                \
+{                                                                       \
+        TYPE snap[(DEGREE << 1) - 1];                                   \
+        struct NAME ## _node *parent = NULL;                            \
+        struct NAME ## _node *np = NULL;                                \
+        struct NAME ## _node *kid = NULL;                               \
+        uint64_t pv = 0;                                                \
+        uint64_t kv = 0;                                                \
+        uint64_t v = 0;                                                 \
+        int pidx = -1;                                                  \
+        int len = -1;                                                   \
+        int ret = -1;                                                   \
+        int i = -1;                                                     \
+                                                                        \
+restart:                                                                \
+        np = atomic_load(&bp->b_root);                                  \
+        if (np == NULL) {                                               \
+                np = NAME ## _node_new(true);                           \
+                if (np == NULL)                                         \
+                        return -1;                                      \
+                np->bn_elem[0] = elem;                                  \
+                np->bn_len = 1;                                         \
+                kid = NULL;                                             \
+                if (atomic_compare_exchange_strong(&bp->b_root, &kid,   \
+                                                   np))                 \
+                        return 0;                                       \
+                free(np);                                               \
+                goto restart;                                           \
+        }                                                               \
+        v = btree_olc_read(&np->bn_version);                            \
+        if (atomic_load(&bp->b_root) != np)                             \
+                goto restart;                                           \
+        parent = NULL;                                                  \
+                                                                        \
+        for (;;) {                                                      \
+                if (!NAME ## _node_snap(np, v, snap, &len))             \
+                        goto restart;                                   \
+                                                                        \
+                /* split full nodes on the way down */                  \
+                if (len == ((DEGREE << 1) - 1)) {                       \
+                        ret = NAME ## _node_grow(bp, parent, pv, pidx,  \
+                                                 np, v);                \
+                        if (ret < 0)                                    \
+                                return -1;                              \
+                        goto restart;                                   \
+                }                                                       \
+                                                                        \
+                /* snap was checked, so a match is really in NAME */    \
+                i = KEY ## _upper(snap, len, elem);                     \
+                if (i > 0 && CMP_FN(snap[i - 1], elem) == 0) {          \
+                        errno = EEXIST;                                 \
+                        return -1;                                      \
+                }                                                       \
+                                                                        \
+                if (np->bn_leaf) {                                      \
+                        /* locking at v means bn_elem still is snap */  \
+                        if (!btree_olc_lock(&np->bn_version, v))        \
+                                goto restart;                           \
+                        memmove(&np->bn_elem[i + 1], &np->bn_elem[i],   \
+                                (size_t)(np->bn_len - i) *              \
+                                sizeof(np->bn_elem[0]));                \
+                        np->bn_elem[i] = elem;                          \
+                        np->bn_len++;                                   \
+                        btree_olc_unlock(&np->bn_version);              \
+                        return 0;                                       \
+                }                                                       \
+                                                                        \
+                kid = NAME ## _node_kid(np, v, i, &kv);                 \
+                if (kid == NULL)                                        \
+                        goto restart;                                   \
+                parent = np;                                            \
+                pv = v;                                                 \
+                pidx = i;                                               \
+                np = kid;                                               \
+                v = kv;                                                 \
+        }                                                               \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * find a bound of key in NAME (for internal use only):                 \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *      @eq:            upper bound instead of lower bound?             \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if first element >= key (> key if eq)      \
+ *                      was copied to out                               \
+ *      @failure:       false if there is no such element               \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _bound(struct NAME *bp, TYPE key, bool eq, TYPE *out)           \
+{                                                                       \
+        TYPE snap[(DEGREE << 1) - 1];                                   \
+        struct NAME ## _node *np = NULL;                                \
+        struct NAME ## _node *kid = NULL;                               \
+        uint64_t kv = 0;                                                \
+        uint64_t v = 0;                                                 \
+        bool found = false;                                             \
+        int len = -1;                                                   \
+        int i = -1;                                                     \
+                                                                        \
+restart:                                                                \
+        found = false;                                                  \
+        np = atomic_load(&bp->b_root);                                  \
+        if (np == NULL)                                                 \
+                return false;                                           \
+        v = btree_olc_read(&np->bn_version);                            \
+        if (atomic_load(&bp->b_root) != np)                             \
+                goto restart;                                           \
+                                                                        \
+        for (;;) {                                                      \
+                if (!NAME ## _node_snap(np, v, snap, &len))             \
+                        goto restart;                                   \
+                if (eq)                                                 \
+                        i = KEY ## _upper(snap, len, key);              \
+                else                                                    \
+                        i = KEY ## _lower(snap, len, key);              \
+                /* deeper candidates always come earlier in order */    \
+                if (i < len) {                                          \
+                        *out = snap[i];                                 \
+                        found = true;                                   \
+                }                                                       \
+                if (np->bn_leaf)                                        \
+                        return found;                                   \
+                                                                        \
+                kid = NAME ## _node_kid(np, v, i, &kv);                 \
+                if (kid == NULL)                                        \
+                        goto restart;                                   \
+                np = kid;                                               \
+                v = kv;                                                 \
+        }                                                               \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy first element of NAME not less than key (lock-free):            \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if an element was copied to out            \
+ *      @failure:       false if every element is less than key         \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _lower_bound(struct NAME *bp, TYPE key, TYPE *out)              \
+{                                                                       \
+        return NAME ## _bound(bp, key, false, out);                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy first element of NAME greater than key (lock-free):             \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if an element was copied to out            \
+ *      @failure:       false if no element is greater than key         \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _upper_bound(struct NAME *bp, TYPE key, TYPE *out)              \
+{                                                                       \
+        return NAME ## _bound(bp, key, true, out);                      \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy the elements of NAME that follow a key in one leaf, and the     \
+ * element after that leaf (for internal use only):                     \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *      @eq:            skip elements equal to key?                     \
+ *      @out:           where to copy up to DEGREE << 1 elements        \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       number of elements copied (in order)            \
+ *      @failure:       0 if no element is >= key (> key if eq)         \
+ */                                                                     \
+LINKAGE int                                                             \
+NAME ## _batch(struct NAME *bp, TYPE key, bool eq, TYPE *out)           \
+{                                                                       \
+        TYPE snap[(DEGREE << 1) - 1];                                   \
+        struct NAME ## _node *np = NULL;                                \
+        struct NAME ## _node *kid = NULL;                               \
+        TYPE next = key;                                                \
+        uint64_t kv = 0;                                                \
+        uint64_t v = 0;                                                 \
+        bool found = false;                                             \
+        int len = -1;                                                   \
+        int i = -1;                                                     \
+                                                                        \
+restart:                                                                \
+        found = false;                                                  \
+        np = atomic_load(&bp->b_root);                                  \
+        if (np == NULL)                                                 \
+                return 0;                                               \
+        v = btree_olc_read(&np->bn_version);                            \
+        if (atomic_load(&bp->b_root) != np)                             \
+                goto restart;                                           \
+                                                                        \
+        for (;;) {                                                      \
+                if (!NAME ## _node_snap(np, v, snap, &len))             \
+                        goto restart;                                   \
+                if (eq)                                                 \
+                        i = KEY ## _upper(snap, len, key);              \
+                else                                                    \
+                        i = KEY ## _lower(snap, len, key);              \
+                if (np->bn_leaf)                                        \
+                        break;                                          \
+                /* the deepest such separator follows the leaf */       \
+                if (i < len) {                                          \
+                        next = snap[i];                                 \
+                        found = true;                                   \
+                }                                                       \
+                                                                        \
+                kid = NAME ## _node_kid(np, v, i, &kv);                 \
+                if (kid == NULL)                                        \
+                        goto restart;                                   \
+                np = kid;                                               \
+                v = kv;                                                 \
+        }                                                               \
+                                                                        \
+        len -= i;                                                       \
+        memcpy(out, &snap[i], (size_t)len * sizeof(*out));              \
+        if (found)                                                      \
+                out[len++] = next;                                      \
+        return len;                                                     \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * start a lock-free scan of NAME; each refill copies the rest of one   \
+ * leaf under its version latch, and resumes after the last key seen,   \
+ * so a scan sees every key that was in NAME before it started once,    \
+ * in order, and may or may not see keys added while it runs:           \
+ *                                                                      \
+ * args:                                                                \
+ *      @sp:            pointer to NAME ## _scan                        \
+ *      @bp:            pointer to NAME                                 \
+ *      @lo:            lowest element to visit                         \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _scan_start(struct NAME ## _scan *sp, struct NAME *bp, TYPE lo) \
+{                                                                       \
+        sp->sc_tree = bp;                                               \
+        sp->sc_len = NAME ## _batch(bp, lo, false, sp->sc_elem);        \
+        sp->sc_idx = 0;                                                 \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy next element of a lock-free scan:                               \
+ *                                                                      \
+ * args:                                                                \
+ *      @sp:            pointer to NAME ## _scan                        \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if an element was copied to out            \
+ *      @failure:       false at end of NAME                            \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _scan_next(struct NAME ## _scan *sp, TYPE *out)                 \
+{                                                                       \
+        TYPE last;                                                      \
+                                                                        \
+        if (sp->sc_idx == sp->sc_len) {                                 \
+                if (sp->sc_len == 0)                                    \
+                        return false;                                   \
+                last = sp->sc_elem[sp->sc_len - 1];                     \
+                sp->sc_len = NAME ## _batch(sp->sc_tree, last, true,    \
+                                            sp->sc_elem);               \
+                sp->sc_idx = 0;                                         \
+                if (sp->sc_len == 0)                                    \
+                        return false;                                   \
+        }                                                               \
+                                                                        \
+        *out = sp->sc_elem[sp->sc_idx++];                               \
+        return true;                                                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * copy element of NAME equal to key (lock-free):                       \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *      @out:           where to copy element                           \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if an element was copied to out            \
+ *      @failure:       false if key is not in NAME                     \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _find(struct NAME *bp, TYPE key, TYPE *out)                     \
+{                                                                       \
+        TYPE elem;                                                      \
+                                                                        \
+        if (!NAME ## _bound(bp, key, false, &elem))                     \
+                return false;                                           \
+        if (CMP_FN(elem, key) != 0)                                     \
+                return false;                                           \
+        *out = elem;                                                    \
+        return true;                                                    \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * is key in NAME? (lock-free)                                          \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *      @key:           key to search for                               \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       true if key is in NAME, false if not            \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE bool                                                            \
+NAME ## _contains(struct NAME *bp, TYPE key)                            \
+{                                                                       \
+        TYPE elem;                                                      \
+                                                                        \
+        return NAME ## _find(bp, key, &elem);                           \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * free memory allocated by NAME ## _node (for internal use only):      \
+ *                                                                      \
+ * args:                                                                \
+ *      @np:            pointer to NAME ## _node                        \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _node_free(struct NAME ## _node *np)                            \
+{                                                                       \
+        int i = -1;                                                     \
+                                                                        \
+        if (np == NULL)                                                 \
+                return;                                                 \
+                                                                        \
+        if (!np->bn_leaf) {                                             \
+                for (i = 0; i <= np->bn_len; i++)                       \
+                        NAME ## _node_free(BTREE_KIDS(NAME, np)[i]);    \
+        }                                                               \
+                                                                        \
+        free(np);                                                       \
+}                                                                       \
+                                                                        \
+/**                                                                     \
+ * free memory allocated by NAME (once no other thread uses it):        \
+ *                                                                      \
+ * args:                                                                \
+ *      @bp:            pointer to NAME                                 \
+ *                                                                      \
+ * ret:                                                                 \
+ *      @success:       nothing                                         \
+ *      @failure:       does not fail                                   \
+ */                                                                     \
+LINKAGE void                                                            \
+NAME ## _free(struct NAME *bp)                                          \
+{                                                                       \
+        NAME ## _node_free(atomic_load(&bp->b_root));                   \
+        atomic_store(&bp->b_root, NULL);                                \
+}
+
+#endif /* BTREE_OLC_H */
@@ -1,337 +1,218 @@
-#include <stdbool.h>
-#include <stdlib.h>
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include "btree.h"
+
+/* bytes read from a pipe at a time */
+#define READ_BLOCK      (1 << 20)
+
+BTREE_DEFINE_KEY(, struct btree_str, 8, btree_str_cmp, strlist, btree_str)
+
+/* whole input in one buffer that lines point into */
+struct input {
+        /* input bytes */
+        char            *in_buf;
+        /* number of input bytes */
+        size_t          in_len;
+        /* is in_buf mapped instead of allocated? */
+        bool            in_mapped;
+};
+
+static void
+printstr(struct btree_str s)
+{
+        /* printf("%.*s\n", (int)s.bs_len, s.bs_ptr); */
+        (void)s;
+}
+
+static void
+usage(void)
+{
+        fprintf(stderr, "usage: a.out [-s file | -m file] [file]\n");
+        exit(EX_USAGE);
+}
 
 /**
- * define a new btree:
+ * read all of a file into an input:
  *
  * args:
- *      @LINKAGE:       linkage of generated functions
- *      @TYPE:          element type
- *      @DEGREE:        degree of btree nodes
- *      @CMP_FN:        element comparison function
- *      @NAME:          name of generated struct
+ *      @ip:            pointer to input
+ *      @fd:            file to read
  *
  * ret:
- *      @success:       generated btree struct and functions
- *      @failure:       does not fail
+ *      @success:       0
+ *      @failure:       -1 and errno set
  */
-#define BTREE_DEFINE(LINKAGE, TYPE, DEGREE, CMP_FN, NAME)               \
-                                                                        \
-/* btree node */                                                        \
-struct NAME ## _node {                                                  \
-        /* array of pointers to children */                             \
-        struct NAME ## _node    *bn_kids[(DEGREE << 1)];                \
-        /* elements */                                                  \
-        TYPE                    bn_elem[(DEGREE << 1) - 1];             \
-        /* is this node a leaf? */                                      \
-        bool                    bn_leaf;                                \
-        /* number of keys in node */                                    \
-        int                     bn_len;                                 \
-};                                                                      \
-                                                                        \
-/* btree */                                                             \
-struct NAME {                                                           \
-        /* root node of btree */                                        \
-        struct NAME ## _node    *b_root;                                \
-};                                                                      \
-                                                                        \
-/**                                                                     \
- * initialize a NAME:                                                   \
- *                                                                      \
- * args:                                                                \
- *      @bp:            pointer to NAME                                 \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       nothing                                         \
- *      @failure:       does not fail                                   \
- */                                                                     \
-LINKAGE void                                                            \
-NAME ## _init(struct NAME *bp)                                          \
-{                                                                       \
-        bp->b_root = NULL;                                              \
-}                                                                       \
-                                                                        \
-/**                                                                     \
- * create a new NAME ## _node (for internal use only):                  \
- *                                                                      \
- * args:                                                                \
- *      @leaf:          is this node a leaf?                            \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       pointer to new NAME ## _node                    \
- *      @failure:       NULL and errno set                              \
- */                                                                     \
-LINKAGE struct NAME ## _node *                                          \
-NAME ## _node_new(bool leaf)                                            \
-{                                                                       \
-        struct NAME ## _node *np = NULL;                                \
-                                                                        \
-        np = malloc(sizeof(*np));                                       \
-        if (np == NULL)                                                 \
-                return NULL;                                            \
-                                                                        \
-        np->bn_leaf = leaf;                                             \
-        np->bn_len = 0;                                                 \
-        return np;                                                      \
-}                                                                       \
-                                                                        \
-/**                                                                     \
- * split a NAME ## _node (for internal use only):                       \
- *                                                                      \
- * args:                                                                \
- *      @np:            pointer to NAME ## _node                        \
- *      @kid:           kid to split                                    \
- *      @idx:           index to split on                               \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       0                                               \
- *      @failure:       -1 and errno set                                \
- */                                                                     \
-LINKAGE int                                                             \
-NAME ## _node_split(struct NAME ## _node *np,                           \
-                    struct NAME ## _node *kid,                          \
-                    int idx)                                            \
-{                                                                       \
-        struct NAME ## _node *new = NULL;                               \
-        int i = -1;                                                     \
-                                                                        \
-        new = NAME ## _node_new(kid->bn_leaf);                          \
-        if (new == NULL)                                                \
-                return -1;                                              \
-                                                                        \
-        new->bn_len = DEGREE - 1;                                       \
-        for (i = 0; i < (DEGREE - 1); i++)                              \
-                new->bn_elem[i] = kid->bn_elem[DEGREE + i];             \
-        if (!kid->bn_leaf) {                                            \
-                for (i = 0; i < DEGREE; i++)                            \
-                        new->bn_kids[i] = kid->bn_kids[DEGREE + i];     \
-        }                                                               \
-        kid->bn_len = DEGREE - 1;                                       \
-                                                                        \
-        for (i = np->bn_len; i >= idx + 1; i--)                         \
-                np->bn_kids[i + 1] = np->bn_kids[i];                    \
-        np->bn_kids[idx + 1] = new;                                     \
-                                                                        \
-        for (i = np->bn_len - 1; i >= idx; i--)                         \
-                np->bn_elem[i + 1] = np->bn_elem[i];                    \
-        np->bn_elem[idx] = kid->bn_elem[DEGREE - 1];                    \
-                                                                        \
-        np->bn_len++;                                                   \
-        return 0;                                                       \
-}                                                                       \
-                                                                        \
-/**                                                                     \
- * add an element to NAME ## _node (for internal use only):             \
- *                                                                      \
- * args:                                                                \
- *      @np:            pointer to NAME ## _node                        \
- *      @elem:          element to add                                  \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       0                                               \
- *      @failure:       -1 and errno set                                \
- */                                                                     \
-LINKAGE int                                                             \
-NAME ## _node_add(struct NAME ## _node *np, TYPE elem)                  \
-{                                                                       \
-        struct NAME ## _node *kid = NULL;                               \
-        int i = -1;                                                     \
-                                                                        \
-        if (np->bn_leaf) {                                              \
-                i = np->bn_len - 1;                                     \
-                while (i >= 0 && CMP_FN(np->bn_elem[i], elem) > 0) {    \
-                        np->bn_elem[i + 1] = np->bn_elem[i];            \
-                        i--;                                            \
-                }                                                       \
-                np->bn_elem[i + 1] = elem;                              \
-                np->bn_len++;                                           \
-                return 0;                                               \
-        }                                                               \
-                                                                        \
-        i = np->bn_len - 1;                                             \
-        while (i >= 0 && CMP_FN(np->bn_elem[i], elem) > 0)              \
-                i--;                                                    \
-                                                                        \
-        if (np->bn_kids[i + 1]->bn_len == ((DEGREE << 1) - 1)) {        \
-                kid = np->bn_kids[i + 1];                               \
-                if (NAME ## _node_split(np, kid, i + 1) < 0)            \
-                        return -1;                                      \
-                if (CMP_FN(np->bn_elem[i + 1], elem) < 0)               \
-                        i++;                                            \
-        }                                                               \
-                                                                        \
-        NAME ## _node_add(np->bn_kids[i + 1], elem);                    \
-        return 0;                                                       \
-}                                                                       \
-                                                                        \
-/**                                                                     \
- * add element to NAME:                                                 \
- *                                                                      \
- * args:                                                                \
- *      @bp:            pointer to NAME                                 \
- *      @elem:          element to add                                  \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       0                                               \
- *      @failure:       -1 and errno set                                \
- */                                                                     \
-LINKAGE int                                                             \
-NAME ## _add(struct NAME *bp, TYPE elem)                                \
-{                                                                       \
-        struct NAME ## _node *new = NULL;                               \
-        int i = -1;                                                     \
-                                                                        \
-        if (bp->b_root == NULL) {                                       \
-                bp->b_root = NAME ## _node_new(true);                   \
-                if (bp->b_root == NULL)                                 \
-                        return -1;                                      \
-                bp->b_root->bn_elem[0] = elem;                          \
-                bp->b_root->bn_len = 1;                                 \
-                return 0;                                               \
-        }                                                               \
-                                                                        \
-        if (bp->b_root->bn_len == ((DEGREE << 1) - 1)) {                \
-                new = NAME ## _node_new(false);                         \
-                if (new == NULL)                                        \
-                        return -1;                                      \
-                new->bn_kids[0] = bp->b_root;                           \
-                if (NAME ## _node_split(new, bp->b_root, 0) < 0) {      \
-                        free(new);                                      \
-                        return -1;                                      \
-                }                                                       \
-                i = 0;                                                  \
-                if (CMP_FN(new->bn_elem[0], elem) < 0)                  \
-                        i++;                                            \
-                (void)NAME ## _node_add(new->bn_kids[i], elem);         \
-                bp->b_root = new;                                       \
-                return 0;                                               \
-        }                                                               \
-                                                                        \
-        return NAME ## _node_add(bp->b_root, elem);                     \
-}                                                                       \
-                                                                        \
-/**                                                                     \
- * iterate through NAME ## _node elements (for internal use only):      \
- *                                                                      \
- * args:                                                                \
- *      @np:            pointer to NAME ## _node                        \
- *      @fn:            pointer to function to run on elements          \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       nothing                                         \
- *      @failure:       does not fail                                   \
- */                                                                     \
-LINKAGE void                                                            \
-NAME ## _node_for_each(struct NAME ## _node *np, void (*fn)(TYPE))      \
-{                                                                       \
-        int i = -1;                                                     \
-                                                                        \
-        if (np == NULL)                                                 \
-                return;                                                 \
-                                                                        \
-        for (i = 0; i < np->bn_len; i++) {                              \
-                if (!np->bn_leaf)                                       \
-                        NAME ## _node_for_each(np->bn_kids[i], fn);     \
-                fn(np->bn_elem[i]);                                     \
-        }                                                               \
-                                                                        \
-        if (!np->bn_leaf)                                               \
-                NAME ## _node_for_each(np->bn_kids[i], fn);             \
-}                                                                       \
-                                                                        \
-/**                                                                     \
- * iterate through NAME elements:                                       \
- *                                                                      \
- * args:                                                                \
- *      @bp:            pointer to NAME                                 \
- *      @fn:            pointer to function to run on elements          \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       nothing                                         \
- *      @failure:       does not fail                                   \
- */                                                                     \
-LINKAGE void                                                            \
-NAME ## _for_each(struct NAME *bp, void (*fn)(TYPE))                    \
-{                                                                       \
-        NAME ## _node_for_each(bp->b_root, fn);                         \
-}                                                                       \
-                                                                        \
-/**                                                                     \
- * free memory allocated by NAME ## _node (for internal use only):      \
- *                                                                      \
- * args:                                                                \
- *      @np:            pointer to NAME ## _node                        \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       nothing                                         \
- *      @failure:       does not fail                                   \
- */                                                                     \
-LINKAGE void                                                            \
-NAME ## _node_free(struct NAME ## _node *np)                            \
-{                                                                       \
-        int i = -1;                                                     \
-                                                                        \
-        if (np == NULL)                                                 \
-                return;                                                 \
-                                                                        \
-        for (i = 0; i < np->bn_len; i++) {                              \
-                if (!np->bn_leaf)                                       \
-                        NAME ## _node_free(np->bn_kids[i]);             \
-        }                                                               \
-                                                                        \
-        if (!np->bn_leaf)                                               \
-                NAME ## _node_free(np->bn_kids[i]);                     \
-                                                                        \
-        free(np);                                                       \
-}                                                                       \
-                                                                        \
-/**                                                                     \
- * free memory allocated by NAME:                                       \
- *                                                                      \
- * args:                                                                \
- *      @bp:            pointer to NAME                                 \
- *                                                                      \
- * ret:                                                                 \
- *      @success:       nothing                                         \
- *      @failure:       does not fail                                   \
- */                                                                     \
-LINKAGE void                                                            \
-NAME ## _free(struct NAME *bp)                                          \
-{                                                                       \
-        NAME ## _node_free(bp->b_root);                                 \
-        bp->b_root = NULL;                                              \
-}
+static int
+input_read(struct input *ip, int fd)
+{
+        struct stat st = {0};
+        size_t cap = READ_BLOCK;
+        char *buf = NULL;
+        ssize_t n = 0;
 
-#include <err.h>
-#include <stdio.h>
-#include <string.h>
-#include <sysexits.h>
+        ip->in_buf = NULL;
+        ip->in_len = 0;
+        ip->in_mapped = false;
+
+        /* regular files are mapped: no copy and no growing */
+        if (fstat(fd, &st) < 0)
+                return -1;
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+                buf = mmap(NULL, (size_t)st.st_size, PROT_READ,
+                           MAP_PRIVATE, fd, 0);
+                if (buf == MAP_FAILED)
+                        return -1;
+                madvise(buf, (size_t)st.st_size, MADV_SEQUENTIAL);
+                ip->in_buf = buf;
+                ip->in_len = (size_t)st.st_size;
+                ip->in_mapped = true;
+                return 0;
+        }
 
-BTREE_DEFINE(, char *, 8, strcmp, strlist)
+        ip->in_buf = malloc(cap);
+        if (ip->in_buf == NULL)
+                return -1;
+        for (;;) {
+                if (cap - ip->in_len < READ_BLOCK) {
+                        cap <<= 1;
+                        buf = realloc(ip->in_buf, cap);
+                        if (buf == NULL)
+                                return -1;
+                        ip->in_buf = buf;
+                }
+                n = read(fd, ip->in_buf + ip->in_len, READ_BLOCK);
+                if (n < 0 && errno == EINTR)
+                        continue;
+                if (n < 0)
+                        return -1;
+                if (n == 0)
+                        return 0;
+                ip->in_len += (size_t)n;
+        }
+}
 
+/**
+ * release an input:
+ *
+ * args:
+ *      @ip:            pointer to input
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       does not fail
+ */
 static void
-printstr(char *s)
+input_free(struct input *ip)
+{
+        if (ip->in_mapped)
+                munmap(ip->in_buf, ip->in_len);
+        else
+                free(ip->in_buf);
+        ip->in_buf = NULL;
+        ip->in_len = 0;
+}
+
+/**
+ * add every line of an input to a strlist (without newlines):
+ *
+ * args:
+ *      @lp:            pointer to strlist
+ *      @ip:            pointer to input
+ *
+ * ret:
+ *      @success:       0
+ *      @failure:       -1 and errno set
+ */
+static int
+input_lines(struct strlist *lp, struct input *ip)
 {
-        /* printf("%s", s); */
-        free(s);
+        char *end = ip->in_buf + ip->in_len;
+        char *p = ip->in_buf;
+        char *nl = NULL;
+
+        while (p < end) {
+                nl = memchr(p, '\n', (size_t)(end - p));
+                if (nl == NULL)
+                        nl = end;
+                if (strlist_add(lp, btree_str_make(p, (size_t)(nl - p))) < 0)
+                        return -1;
+                p = nl + 1;
+        }
+
+        return 0;
 }
 
 int
 main(int argc, char **argv)
 {
+        struct strlist_cursor cur = {0};
+        struct btree_map map = {0};
         struct strlist args = {0};
-        char buf[BUFSIZ] = "";
-        char *dup = NULL;
+        struct input in = {0};
+        struct btree_str *sp = NULL;
+        char *save = NULL;
+        char *path = NULL;
+        int fd = -1;
+        int c = 0;
+
+        while ((c = getopt(argc, argv, "m:s:")) != -1) {
+                switch (c) {
+                case 'm':
+                        path = optarg;
+                        break;
+                case 's':
+                        save = optarg;
+                        break;
+                default:
+                        usage();
+                }
+        }
+        if (optind < argc - 1 || (path != NULL && save != NULL))
+                usage();
+        if (path != NULL && optind != argc)
+                usage();
+
+        if (path != NULL) {
+                if (strlist_open_mmap(&map, path) < 0)
+                        err(EX_NOINPUT, "%s", path);
+                strlist_map_for_each(&map, printstr);
+                btree_map_close(&map);
+                return 0;
+        }
+
+        fd = STDIN_FILENO;
+        if (optind < argc) {
+                fd = open(argv[optind], O_RDONLY);
+                if (fd < 0)
+                        err(EX_NOINPUT, "%s", argv[optind]);
+        }
+        if (input_read(&in, fd) < 0)
+                err(EX_IOERR, "read");
+        if (fd != STDIN_FILENO)
+                close(fd);
+
+        strlist_init_pool(&args);
+        if (input_lines(&args, &in) < 0)
+                err(EX_SOFTWARE, "strlist_add");
 
-        strlist_init(&args);
-        while (fgets(buf, sizeof(buf), stdin) != NULL) {
-                dup = strdup(buf);
-                if (dup == NULL)
-                        err(EX_SOFTWARE, "strdup");
-                if (strlist_add(&args, dup) < 0)
-                        err(EX_SOFTWARE, "strlist_add");
+        if (save != NULL) {
+                fd = open(save, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0)
+                        err(EX_CANTCREAT, "%s", save);
+                if (strlist_save(&args, fd) < 0)
+                        err(EX_IOERR, "%s", save);
+                close(fd);
         }
 
-        strlist_for_each(&args, printstr);
+        BTREE_FOREACH(strlist, &cur, &args, sp)
+                printstr(*sp);
         strlist_free(&args);
+        input_free(&in);
 }
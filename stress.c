@@ -0,0 +1,374 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "btree_olc.h"
+
+/* default number of elements to insert */
+#define NELEM   2000000
+
+static int
+i32cmp(int32_t a, int32_t b)
+{
+        return (a > b) - (a < b);
+}
+
+BTREE_OLC_DEFINE(static inline, int32_t, 16, i32cmp, olc)
+
+/* work handed to each thread */
+struct job {
+        /* shared tree */
+        struct olc      *j_tree;
+        /* first index to handle */
+        size_t          j_first;
+        /* stride between indexes */
+        size_t          j_step;
+        /* number of indexes in total */
+        size_t          j_n;
+        /* insert instead of look up? */
+        bool            j_add;
+        /* keys added before a mixed run started */
+        size_t          j_pre;
+        /* writers still running (NULL unless a mixed run) */
+        atomic_size_t   *j_live;
+        /* number of lookups that missed */
+        size_t          j_miss;
+};
+
+/**
+ * get key number i (a bijection, so keys never repeat):
+ *
+ * args:
+ *      @i:             key number
+ *
+ * ret:
+ *      @success:       key
+ *      @failure:       does not fail
+ */
+static int32_t
+key(size_t i)
+{
+        return (int32_t)((uint32_t)i * 2654435761u);
+}
+
+/**
+ * get key number of a key (inverse of key()):
+ *
+ * args:
+ *      @k:             key
+ *
+ * ret:
+ *      @success:       key number
+ *      @failure:       does not fail
+ */
+static size_t
+unkey(int32_t k)
+{
+        /* 0x0e8b2f51 * 2654435761 == 1 (mod 2^32) */
+        return (size_t)((uint32_t)k * 0x0e8b2f51u);
+}
+
+/**
+ * get current time:
+ *
+ * args:
+ *      none
+ *
+ * ret:
+ *      @success:       monotonic time in nanoseconds
+ *      @failure:       does not fail
+ */
+static double
+now(void)
+{
+        struct timespec ts = {0};
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * check a tree that writers are adding keys j_pre to j_n - 1 to: every
+ * key below j_pre must be found by lookups and scans all along:
+ *
+ * args:
+ *      @jp:            pointer to struct job
+ *
+ * ret:
+ *      @success:       nothing (misses are added to j_miss)
+ *      @failure:       exits if a scan is out of order
+ */
+static void
+check(struct job *jp)
+{
+        struct olc_scan scan = {0};
+        int32_t prev = 0;
+        int32_t e = 0;
+        size_t seen = 0;
+        size_t cnt = 0;
+        size_t i = 0;
+
+        for (i = jp->j_first; i < jp->j_pre; i += jp->j_step) {
+                jp->j_miss += !olc_contains(jp->j_tree, key(i));
+                if (!olc_lower_bound(jp->j_tree, key(i), &e) || e != key(i))
+                        jp->j_miss++;
+                if (olc_upper_bound(jp->j_tree, key(i), &e) && e <= key(i)) {
+                        fprintf(stderr, "upper_bound went backwards\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        olc_scan_start(&scan, jp->j_tree, INT32_MIN);
+        while (olc_scan_next(&scan, &e)) {
+                if ((cnt != 0 && e <= prev) || unkey(e) >= jp->j_n) {
+                        fprintf(stderr, "bad scan at %zu\n", cnt);
+                        exit(EXIT_FAILURE);
+                }
+                seen += unkey(e) < jp->j_pre;
+                prev = e;
+                cnt++;
+        }
+        jp->j_miss += jp->j_pre - seen;
+}
+
+/**
+ * run one thread's share of a job:
+ *
+ * args:
+ *      @arg:           pointer to struct job
+ *
+ * ret:
+ *      @success:       NULL
+ *      @failure:       exits
+ */
+static void *
+work(void *arg)
+{
+        struct job *jp = arg;
+        size_t i = 0;
+
+        /* readers of a mixed run go on until every writer is done */
+        if (!jp->j_add && jp->j_live != NULL) {
+                do
+                        check(jp);
+                while (atomic_load(jp->j_live) != 0);
+                return NULL;
+        }
+
+        for (i = jp->j_first; i < jp->j_n; i += jp->j_step) {
+                if (!jp->j_add) {
+                        jp->j_miss += !olc_contains(jp->j_tree, key(i));
+                } else if (olc_add(jp->j_tree, key(i)) < 0) {
+                        perror("olc_add");
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        if (jp->j_live != NULL)
+                atomic_fetch_sub(jp->j_live, 1);
+        return NULL;
+}
+
+/**
+ * run a job on some threads:
+ *
+ * args:
+ *      @tp:            pointer to shared tree
+ *      @nthr:          number of threads
+ *      @n:             number of elements
+ *      @add:           insert instead of look up?
+ *
+ * ret:
+ *      @success:       millions of operations per second
+ *      @failure:       exits
+ */
+static double
+run(struct olc *tp, size_t nthr, size_t n, bool add)
+{
+        pthread_t *tids = NULL;
+        struct job *jobs = NULL;
+        size_t miss = 0;
+        double t0 = 0;
+        double t1 = 0;
+        size_t i = 0;
+
+        tids = calloc(nthr, sizeof(*tids));
+        jobs = calloc(nthr, sizeof(*jobs));
+        if (tids == NULL || jobs == NULL) {
+                perror("calloc");
+                exit(EXIT_FAILURE);
+        }
+
+        t0 = now();
+        for (i = 0; i < nthr; i++) {
+                jobs[i].j_tree = tp;
+                jobs[i].j_first = i;
+                jobs[i].j_step = nthr;
+                jobs[i].j_n = n;
+                jobs[i].j_add = add;
+                if (pthread_create(&tids[i], NULL, work, &jobs[i]) != 0) {
+                        fprintf(stderr, "pthread_create failed\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        for (i = 0; i < nthr; i++) {
+                pthread_join(tids[i], NULL);
+                miss += jobs[i].j_miss;
+        }
+        t1 = now();
+
+        if (miss != 0) {
+                fprintf(stderr, "%zu keys missing\n", miss);
+                exit(EXIT_FAILURE);
+        }
+
+        free(jobs);
+        free(tids);
+        return (double)n / ((t1 - t0) / 1e9) / 1e6;
+}
+
+/**
+ * add keys n / 2 to n - 1 to a tree holding keys 0 to n / 2 - 1, while
+ * other threads look up and scan the keys that were already there:
+ *
+ * args:
+ *      @tp:            pointer to shared tree
+ *      @nthr:          number of threads (half of them readers)
+ *      @n:             number of elements
+ *
+ * ret:
+ *      @success:       millions of inserts per second
+ *      @failure:       exits
+ */
+static double
+mixed(struct olc *tp, size_t nthr, size_t n)
+{
+        size_t nw = nthr > 1 ? (nthr + 1) >> 1 : 1;
+        size_t nr = nthr > nw ? nthr - nw : 1;
+        atomic_size_t live = nw;
+        pthread_t *tids = NULL;
+        struct job *jobs = NULL;
+        size_t miss = 0;
+        double t0 = 0;
+        double t1 = 0;
+        size_t i = 0;
+
+        tids = calloc(nw + nr, sizeof(*tids));
+        jobs = calloc(nw + nr, sizeof(*jobs));
+        if (tids == NULL || jobs == NULL) {
+                perror("calloc");
+                exit(EXIT_FAILURE);
+        }
+
+        t0 = now();
+        for (i = 0; i < nw + nr; i++) {
+                jobs[i].j_tree = tp;
+                jobs[i].j_add = i < nw;
+                jobs[i].j_first = i < nw ? (n >> 1) + i : i - nw;
+                jobs[i].j_step = i < nw ? nw : nr;
+                jobs[i].j_n = n;
+                jobs[i].j_pre = n >> 1;
+                jobs[i].j_live = &live;
+                if (pthread_create(&tids[i], NULL, work, &jobs[i]) != 0) {
+                        fprintf(stderr, "pthread_create failed\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        for (i = 0; i < nw + nr; i++) {
+                pthread_join(tids[i], NULL);
+                miss += jobs[i].j_miss;
+                if (i == nw - 1)
+                        t1 = now();
+        }
+
+        if (miss != 0) {
+                fprintf(stderr, "%zu old keys missed during inserts\n",
+                        miss);
+                exit(EXIT_FAILURE);
+        }
+
+        free(jobs);
+        free(tids);
+        return (double)(n - (n >> 1)) / ((t1 - t0) / 1e9) / 1e6;
+}
+
+/**
+ * check that a tree holds keys 0 to n - 1 in order:
+ *
+ * args:
+ *      @tp:            pointer to tree
+ *      @n:             number of elements
+ *
+ * ret:
+ *      @success:       nothing
+ *      @failure:       exits
+ */
+static void
+verify(struct olc *tp, size_t n)
+{
+        struct olc_scan scan = {0};
+        int32_t prev = 0;
+        int32_t e = 0;
+        size_t cnt = 0;
+
+        olc_scan_start(&scan, tp, INT32_MIN);
+        while (olc_scan_next(&scan, &e)) {
+                if (cnt != 0 && e <= prev) {
+                        fprintf(stderr, "out of order at %zu\n", cnt);
+                        exit(EXIT_FAILURE);
+                }
+                prev = e;
+                cnt++;
+        }
+
+        if (cnt != n) {
+                fprintf(stderr, "scanned %zu of %zu keys\n", cnt, n);
+                exit(EXIT_FAILURE);
+        }
+}
+
+int
+main(int argc, char **argv)
+{
+        struct olc tree = {0};
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t n = NELEM;
+        size_t nthr = 1;
+        double add = 0;
+        double get = 0;
+        double mix = 0;
+
+        if (argc > 1)
+                n = strtoul(argv[1], NULL, 10);
+        if (argc > 2)
+                ncpu = strtol(argv[2], NULL, 10);
+        if (n == 0)
+                n = NELEM;
+        if (ncpu < 1)
+                ncpu = 1;
+
+        printf("threads,insert_mops,lookup_mops,mixed_insert_mops\n");
+        for (nthr = 1; ; nthr <<= 1) {
+                if (nthr > (size_t)ncpu)
+                        nthr = (size_t)ncpu;
+                olc_init(&tree);
+                add = run(&tree, nthr, n, true);
+                get = run(&tree, nthr, n, false);
+                verify(&tree, n);
+                olc_free(&tree);
+
+                olc_init(&tree);
+                run(&tree, nthr, n >> 1, true);
+                mix = mixed(&tree, nthr, n);
+                verify(&tree, n);
+                olc_free(&tree);
+                printf("%zu,%.2f,%.2f,%.2f\n", nthr, add, get, mix);
+                if (nthr == (size_t)ncpu)
+                        break;
+        }
+
+        return 0;
+}